@@ -0,0 +1,418 @@
+// Воспроизводимые замеры производительности поискового сервера. Собирается отдельной
+// программой из всех файлов, кроме main.cpp, и пишет результаты в JSON:
+//   benchmark [--documents=N] [--document-length=N] [--vocabulary=N] [--zipf=S]
+//             [--queries=N] [--query-length=N] [--minus-ratio=P] [--duplicate-ratio=P]
+//             [--removed=N] [--written=N] [--seed=N] [--output=FILE]
+// Корпус и запросы зависят только от параметров: генератор и распределения свои,
+// а не из <random>, чьи распределения разные в разных стандартных библиотеках.
+
+#include "concurrent_search_server.h"
+#include "log_duration.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <random>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct BenchmarkConfig {
+    int document_count = 100'000;
+    int document_length = 50;
+    int vocabulary_size = 50'000;
+    // показатель закона Ципфа: частота слова пропорциональна 1 / rank^zipf_exponent
+    double zipf_exponent = 1.0;
+    int query_count = 10'000;
+    int query_length = 4;
+    double minus_ratio = 0.1;
+    // доля документов, повторяющих один из предыдущих
+    double duplicate_ratio = 0.05;
+    int removed_count = 10'000;
+    // документов, добавляемых во время поиска из нескольких потоков
+    int written_count = 10'000;
+    uint64_t seed = 42;
+    string output;
+};
+
+struct BenchmarkResult {
+    string name;
+    uint64_t operations = 0;
+    chrono::nanoseconds total{0};
+    // перцентили длительности одной операции, если она замерялась
+    bool has_latency = false;
+    DurationStats latency{};
+};
+
+// Равномерное число из [0, 1) из 53 старших битов mt19937_64, чья последовательность
+// определена стандартом
+double NextUniform(mt19937_64& generator) {
+    return (generator() >> 11) * 0x1.0p-53;
+}
+
+class ZipfDistribution {
+public:
+    ZipfDistribution(int size, double exponent)
+        : cumulative_weights_(size) {
+        double sum = 0.0;
+        for (int rank = 0; rank < size; ++rank) {
+            sum += 1.0 / pow(rank + 1, exponent);
+            cumulative_weights_[rank] = sum;
+        }
+    }
+
+    // Номер слова от 0, самые частые - с меньшими номерами
+    int operator()(mt19937_64& generator) const {
+        const double value = NextUniform(generator) * cumulative_weights_.back();
+        const auto it = upper_bound(cumulative_weights_.begin(), cumulative_weights_.end(), value);
+        return min<int>(it - cumulative_weights_.begin(), cumulative_weights_.size() - 1);
+    }
+
+private:
+    vector<double> cumulative_weights_;
+};
+
+// Слово по номеру: номер в системе счисления по основанию 26, не короче трёх букв
+string MakeWord(int index) {
+    string word;
+    do {
+        word.push_back('a' + index % 26);
+        index /= 26;
+    } while (index > 0 || word.size() < 3);
+    return word;
+}
+
+struct Corpus {
+    vector<string> documents;
+    vector<DocumentStatus> statuses;
+    vector<vector<int>> ratings;
+    vector<string> queries;
+};
+
+Corpus GenerateCorpus(const BenchmarkConfig& config) {
+    mt19937_64 generator(config.seed);
+    const ZipfDistribution zipf(config.vocabulary_size, config.zipf_exponent);
+    vector<string> vocabulary(config.vocabulary_size);
+    for (int i = 0; i < config.vocabulary_size; ++i) {
+        vocabulary[i] = MakeWord(i);
+    }
+
+    Corpus corpus;
+    corpus.documents.reserve(config.document_count);
+    for (int id = 0; id < config.document_count; ++id) {
+        if (id > 0 && NextUniform(generator) < config.duplicate_ratio) {
+            corpus.documents.push_back(corpus.documents[generator() % id]);
+        } else {
+            string document;
+            for (int i = 0; i < config.document_length; ++i) {
+                if (i > 0) {
+                    document.push_back(' ');
+                }
+                document += vocabulary[zipf(generator)];
+            }
+            corpus.documents.push_back(move(document));
+        }
+        // примерно каждый десятый документ не ACTUAL
+        corpus.statuses.push_back(generator() % 10 == 0 ? static_cast<DocumentStatus>(1 + generator() % 3)
+                                                        : DocumentStatus::ACTUAL);
+        corpus.ratings.push_back({static_cast<int>(generator() % 10), static_cast<int>(generator() % 10)});
+    }
+
+    corpus.queries.reserve(config.query_count);
+    for (int q = 0; q < config.query_count; ++q) {
+        string query;
+        for (int i = 0; i < config.query_length; ++i) {
+            if (i > 0) {
+                query.push_back(' ');
+                // первое слово всегда плюс-слово
+                if (NextUniform(generator) < config.minus_ratio) {
+                    query.push_back('-');
+                }
+            }
+            query += vocabulary[zipf(generator)];
+        }
+        corpus.queries.push_back(move(query));
+    }
+    return corpus;
+}
+
+// Замеряет function(i) для i из [0, count): общее время и перцентили одной операции
+template <typename Function>
+BenchmarkResult MeasureEach(const string& name, size_t count, Function function) {
+    DurationHistogram histogram(name);
+    const auto start_time = chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        const auto operation_start_time = chrono::steady_clock::now();
+        function(i);
+        histogram.Add(chrono::steady_clock::now() - operation_start_time);
+    }
+    BenchmarkResult result{name, count, chrono::steady_clock::now() - start_time};
+    result.has_latency = true;
+    result.latency = histogram.GetStats();
+    return result;
+}
+
+// Замеряет function() целиком, выполняющую operations операций
+template <typename Function>
+BenchmarkResult MeasureAll(const string& name, size_t operations, Function function) {
+    const auto start_time = chrono::steady_clock::now();
+    function();
+    return {name, operations, chrono::steady_clock::now() - start_time};
+}
+
+// Поиск в READER_COUNT потоках, пока писатель вызывает write(batch) для batch из
+// [0, batch_count). Каждый читатель выполняет все запросы по одному разу, так что замер
+// конечен, даже если блокировка пропускает читателей вперёд писателя.
+template <typename Search, typename Write>
+void MeasureReadsDuringWrites(const string& name, const vector<string>& queries, Search search,
+                              size_t batch_count, Write write, size_t& checksum, vector<BenchmarkResult>& results) {
+    constexpr size_t READER_COUNT = 2;
+    DurationHistogram histogram(name);
+    const auto start_time = chrono::steady_clock::now();
+    auto writer = async(launch::async, [&]() {
+        for (size_t batch = 0; batch < batch_count; ++batch) {
+            write(batch);
+        }
+        return chrono::steady_clock::now() - start_time;
+    });
+    vector<future<size_t>> readers;
+    for (size_t reader = 0; reader < READER_COUNT; ++reader) {
+        readers.push_back(async(launch::async, [&]() {
+            size_t found = 0;
+            for (const string& query : queries) {
+                const auto operation_start_time = chrono::steady_clock::now();
+                found += search(query).size();
+                histogram.Add(chrono::steady_clock::now() - operation_start_time);
+            }
+            return found;
+        }));
+    }
+    for (auto& reader : readers) {
+        checksum += reader.get();
+    }
+    const auto read_time = chrono::steady_clock::now() - start_time;
+    const auto write_time = writer.get();
+    results.push_back({"FindTopDocuments during writes, "s + name, READER_COUNT * queries.size(), read_time,
+                       true, histogram.GetStats()});
+    results.push_back({"AddDocuments during reads, "s + name, batch_count, write_time});
+}
+
+// Сравнивает задержку поиска во время добавления документов у общего сервера под
+// shared_mutex, где писатель останавливает поиск, и у ConcurrentSearchServer
+void RunConcurrentBenchmarks(const BenchmarkConfig& config, const Corpus& corpus, size_t& checksum,
+                             vector<BenchmarkResult>& results) {
+    constexpr int BATCH_SIZE = 100;
+    vector<NewDocument> documents;
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+        documents.push_back({static_cast<int>(i), corpus.documents[i], corpus.statuses[i], corpus.ratings[i]});
+    }
+    // новые документы повторяют тексты корпуса под новыми id
+    vector<vector<NewDocument>> batches((config.written_count + BATCH_SIZE - 1) / BATCH_SIZE);
+    for (int i = 0; i < config.written_count; ++i) {
+        const size_t index = i % corpus.documents.size();
+        batches[i / BATCH_SIZE].push_back({config.document_count + i, corpus.documents[index],
+                                           corpus.statuses[index], corpus.ratings[index]});
+    }
+
+    {
+        SearchServer search_server("and in on"s);
+        search_server.AddDocuments(documents);
+        shared_mutex mutex;
+        MeasureReadsDuringWrites("SearchServer + shared_mutex"s, corpus.queries,
+            [&](const string& query) {
+                shared_lock lock(mutex);
+                return search_server.FindTopDocuments(query);
+            },
+            batches.size(),
+            [&](size_t batch) {
+                lock_guard lock(mutex);
+                search_server.AddDocuments(batches[batch]);
+            },
+            checksum, results);
+    }
+    {
+        ConcurrentSearchServer search_server("and in on"s);
+        search_server.AddDocuments(documents);
+        MeasureReadsDuringWrites("ConcurrentSearchServer"s, corpus.queries,
+            [&](const string& query) {
+                return search_server.FindTopDocuments(query);
+            },
+            batches.size(),
+            [&](size_t batch) {
+                search_server.AddDocuments(batches[batch]);
+            },
+            checksum, results);
+    }
+}
+
+vector<BenchmarkResult> RunBenchmarks(const BenchmarkConfig& config) {
+    const Corpus corpus = GenerateCorpus(config);
+    vector<BenchmarkResult> results;
+    SearchServer search_server("and in on"s);
+
+    results.push_back(MeasureEach("AddDocument"s, corpus.documents.size(), [&](size_t i) {
+        search_server.AddDocument(i, corpus.documents[i], corpus.statuses[i], corpus.ratings[i]);
+    }));
+
+    // контрольная сумма не даёт компилятору выбросить результаты
+    size_t checksum = 0;
+    results.push_back(MeasureEach("FindTopDocuments seq"s, corpus.queries.size(), [&](size_t i) {
+        checksum += search_server.FindTopDocuments(execution::seq, corpus.queries[i]).size();
+    }));
+    results.push_back(MeasureEach("FindTopDocuments par"s, corpus.queries.size(), [&](size_t i) {
+        checksum += search_server.FindTopDocuments(execution::par, corpus.queries[i]).size();
+    }));
+    results.push_back(MeasureAll("ProcessQueries"s, corpus.queries.size(), [&]() {
+        checksum += ProcessQueries(search_server, corpus.queries).size();
+    }));
+
+    mt19937_64 generator(config.seed + 1);
+    vector<int> document_ids(corpus.queries.size());
+    for (int& id : document_ids) {
+        id = generator() % corpus.documents.size();
+    }
+    results.push_back(MeasureEach("MatchDocument seq"s, corpus.queries.size(), [&](size_t i) {
+        checksum += get<0>(search_server.MatchDocument(execution::seq, corpus.queries[i], document_ids[i])).size();
+    }));
+    results.push_back(MeasureEach("MatchDocument par"s, corpus.queries.size(), [&](size_t i) {
+        checksum += get<0>(search_server.MatchDocument(execution::par, corpus.queries[i], document_ids[i])).size();
+    }));
+
+    {
+        // RemoveDuplicates печатает каждый найденный id
+        ostringstream discarded;
+        streambuf* const cout_buffer = cout.rdbuf(discarded.rdbuf());
+        const int document_count = search_server.GetDocumentCount();
+        results.push_back(MeasureAll("RemoveDuplicates"s, document_count, [&]() {
+            RemoveDuplicates(search_server);
+        }));
+        cout.rdbuf(cout_buffer);
+    }
+
+    vector<int> removed_ids(search_server.begin(), search_server.end());
+    // перемешивание Фишера-Йетса: у std::shuffle порядок зависит от библиотеки
+    for (size_t i = removed_ids.size(); i > 1; --i) {
+        swap(removed_ids[i - 1], removed_ids[generator() % i]);
+    }
+    removed_ids.resize(min<size_t>(removed_ids.size(), config.removed_count));
+    results.push_back(MeasureEach("RemoveDocument"s, removed_ids.size(), [&](size_t i) {
+        search_server.RemoveDocument(removed_ids[i]);
+    }));
+
+    RunConcurrentBenchmarks(config, corpus, checksum, results);
+
+    cerr << "checksum "s << checksum << endl;
+    return results;
+}
+
+void PrintJson(ostream& out, const BenchmarkConfig& config, const vector<BenchmarkResult>& results) {
+    out << "{\n"s;
+    out << "  \"config\": {"s
+        << "\"documents\": "s << config.document_count
+        << ", \"document_length\": "s << config.document_length
+        << ", \"vocabulary\": "s << config.vocabulary_size
+        << ", \"zipf\": "s << config.zipf_exponent
+        << ", \"queries\": "s << config.query_count
+        << ", \"query_length\": "s << config.query_length
+        << ", \"minus_ratio\": "s << config.minus_ratio
+        << ", \"duplicate_ratio\": "s << config.duplicate_ratio
+        << ", \"removed\": "s << config.removed_count
+        << ", \"written\": "s << config.written_count
+        << ", \"seed\": "s << config.seed << "},\n"s;
+    out << "  \"results\": [\n"s;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& result = results[i];
+        const double seconds = chrono::duration<double>(result.total).count();
+        out << "    {\"name\": \""s << result.name << "\""s
+            << ", \"operations\": "s << result.operations
+            << ", \"total_ns\": "s << result.total.count()
+            << ", \"operations_per_second\": "s << (seconds > 0 ? result.operations / seconds : 0.0);
+        if (result.has_latency) {
+            out << ", \"p50_ns\": "s << result.latency.p50.count()
+                << ", \"p99_ns\": "s << result.latency.p99.count()
+                << ", \"p999_ns\": "s << result.latency.p999.count();
+        }
+        out << "}"s << (i + 1 < results.size() ? ","s : ""s) << "\n"s;
+    }
+    out << "  ]\n}\n"s;
+}
+
+BenchmarkConfig ParseArguments(int argc, char* argv[]) {
+    BenchmarkConfig config;
+    for (int i = 1; i < argc; ++i) {
+        const string_view argument = argv[i];
+        const size_t equals = argument.find('=');
+        if (argument.substr(0, 2) != "--"sv || equals == string_view::npos) {
+            throw invalid_argument("Invalid argument "s + string(argument));
+        }
+        const string_view name = argument.substr(2, equals - 2);
+        const string value(argument.substr(equals + 1));
+        if (name == "documents"sv) {
+            config.document_count = stoi(value);
+        } else if (name == "document-length"sv) {
+            config.document_length = stoi(value);
+        } else if (name == "vocabulary"sv) {
+            config.vocabulary_size = stoi(value);
+        } else if (name == "zipf"sv) {
+            config.zipf_exponent = stod(value);
+        } else if (name == "queries"sv) {
+            config.query_count = stoi(value);
+        } else if (name == "query-length"sv) {
+            config.query_length = stoi(value);
+        } else if (name == "minus-ratio"sv) {
+            config.minus_ratio = stod(value);
+        } else if (name == "duplicate-ratio"sv) {
+            config.duplicate_ratio = stod(value);
+        } else if (name == "removed"sv) {
+            config.removed_count = stoi(value);
+        } else if (name == "written"sv) {
+            config.written_count = stoi(value);
+        } else if (name == "seed"sv) {
+            config.seed = stoull(value);
+        } else if (name == "output"sv) {
+            config.output = value;
+        } else {
+            throw invalid_argument("Unknown argument "s + string(argument));
+        }
+    }
+    if (config.document_count <= 0 || config.document_length <= 0 || config.vocabulary_size <= 0
+        || config.query_count <= 0 || config.query_length <= 0 || config.removed_count < 0
+        || config.written_count < 0) {
+        throw invalid_argument("Sizes must be positive"s);
+    }
+    return config;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    BenchmarkConfig config;
+    try {
+        config = ParseArguments(argc, argv);
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    const vector<BenchmarkResult> results = RunBenchmarks(config);
+    if (config.output.empty()) {
+        PrintJson(cout, config, results);
+    } else {
+        ofstream out(config.output);
+        PrintJson(out, config, results);
+    }
+    return 0;
+}
@@ -1,22 +1,33 @@
 #pragma once
 
-#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
-
-
-template <typename Key, typename Value>
+// Хеш-таблица, разбитая на корзины с собственными блокировками.
+// Запись (operator[], Erase) берёт корзину монопольно, чтение (Find) - совместно.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
 class ConcurrentMap {
 private:
-    struct Bucket{
-        std::mutex m_buck;
-        std::map<Key, Value> map;
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    // Выравнивание по кэш-линии, чтобы блокировки соседних корзин не делили одну линию
+    struct alignas(CACHE_LINE_SIZE) Bucket {
+        mutable std::shared_mutex m_buck;
+        std::unordered_map<Key, Value, Hash> map;
     };
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
-
     struct Access {
-        std::lock_guard<std::mutex> guard;
+        std::unique_lock<std::shared_mutex> guard;
         Value& ref_to_value;
 
         Access(const Key& key, Bucket& bucket) : guard(bucket.m_buck), ref_to_value(bucket.map[key]){
@@ -30,26 +41,70 @@ public:
     }
 
     Access operator[](const Key& key){
-        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
-        return {key, bucket};
-    }
-    
-    void Erase(Key key){
-        std::mutex mut;
-        std::lock_guard g(mut);
-        size_t bucket_index = static_cast<size_t>(key) % buckets_.size();
-        buckets_[bucket_index].map.erase(key);
-    }
-    
-    std::map<Key, Value> BuildOrdinaryMap(){
-        std::map<Key, Value> result;
-        for (auto& [mut, map] : buckets_){
-            std::lock_guard g(mut);
-            result.insert(map.begin(), map.end());
+        return {key, GetBucket(key)};
+    }
+
+    std::optional<Value> Find(const Key& key) const {
+        const Bucket& bucket = GetBucket(key);
+        std::shared_lock g(bucket.m_buck);
+        if (auto it = bucket.map.find(key); it != bucket.map.end()) {
+            return it->second;
         }
+        return std::nullopt;
+    }
+
+    void Erase(const Key& key){
+        Bucket& bucket = GetBucket(key);
+        std::lock_guard g(bucket.m_buck);
+        bucket.map.erase(key);
+    }
+
+    // Копирует содержимое всех корзин в вектор (в порядке корзин).
+    // Корзины блокируются на всё время копирования, поэтому результат согласован.
+    std::vector<std::pair<Key, Value>> BuildVector() const {
+        std::vector<std::shared_lock<std::shared_mutex>> guards;
+        guards.reserve(buckets_.size());
+        for (const Bucket& bucket : buckets_) {
+            guards.emplace_back(bucket.m_buck);
+        }
+
+        std::vector<size_t> offsets(buckets_.size());
+        std::transform_exclusive_scan(buckets_.begin(), buckets_.end(), offsets.begin(), size_t{0}, std::plus<>{},
+                                      [](const Bucket& bucket) { return bucket.map.size(); });
+        const size_t total_size = buckets_.empty() ? 0 : offsets.back() + buckets_.back().map.size();
+
+        std::vector<std::pair<Key, Value>> result(total_size);
+        std::vector<size_t> indexes(buckets_.size());
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+            std::copy(buckets_[index].map.begin(), buckets_[index].map.end(), result.begin() + offsets[index]);
+        });
         return result;
     }
 
+    std::map<Key, Value> BuildOrdinaryMap() const {
+        auto items = BuildVector();
+        std::sort(std::execution::par, items.begin(), items.end(),
+                  [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+        // вставка отсортированного диапазона в map линейна
+        return {items.begin(), items.end()};
+    }
+
 private:
     std::vector<Bucket> buckets_;
+
+    size_t GetBucketIndex(const Key& key) const {
+        // хеш целых чисел в стандартной библиотеке тождественный, поэтому перемешиваем его
+        // (мультипликативное хеширование), чтобы ключи с общим шагом не попадали в одну корзину
+        const uint64_t mixed = static_cast<uint64_t>(Hash{}(key)) * 0x9E3779B97F4A7C15ull;
+        return (mixed >> 32) % buckets_.size();
+    }
+
+    Bucket& GetBucket(const Key& key) {
+        return buckets_[GetBucketIndex(key)];
+    }
+
+    const Bucket& GetBucket(const Key& key) const {
+        return buckets_[GetBucketIndex(key)];
+    }
 };
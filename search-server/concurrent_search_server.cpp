@@ -0,0 +1,49 @@
+#include "concurrent_search_server.h"
+
+using namespace std;
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return Read([](const SearchServer& search_server) {
+        return search_server.GetDocumentCount();
+    });
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                         const vector<int>& ratings) {
+    Write([&](SearchServer& search_server) {
+        search_server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::AddDocuments(const vector<NewDocument>& documents) {
+    Write([&documents](SearchServer& search_server) {
+        search_server.AddDocuments(documents);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Write([document_id](SearchServer& search_server) {
+        search_server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    Write([&document_ids](SearchServer& search_server) {
+        search_server.RemoveDocuments(document_ids);
+    });
+}
+
+size_t ConcurrentSearchServer::GetReaderSlot() {
+    // потоки получают счётчики по кругу, чтобы соседние потоки не делили счётчик
+    static atomic<size_t> next_slot = 0;
+    static thread_local const size_t slot = next_slot.fetch_add(1, memory_order_relaxed) % READER_SLOT_COUNT;
+    return slot;
+}
+
+void ConcurrentSearchServer::WaitForReaders(int index) const {
+    for (const ReaderCounter& counter : readers_[index]) {
+        while (counter.count.load(memory_order_seq_cst) != 0) {
+            this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Поисковый сервер для одновременного поиска из многих потоков и изменения из одного.
+// Держит две копии индекса (схема left-right): читатели работают с опубликованной копией,
+// не беря блокировок, писатель меняет вторую копию, публикует её, дожидается ухода
+// читателей прежней копии и повторяет то же изменение в ней. Поиск никогда не ждёт
+// писателя и видит каждое изменение (в том числе пакет документов) целиком или никак;
+// плата за это - двойная память и двойная работа при изменении.
+class ConcurrentSearchServer {
+public:
+    template <typename StringContainer>
+    explicit ConcurrentSearchServer(const StringContainer& stop_words)
+        : servers_{SearchServer(stop_words), SearchServer(stop_words)} {
+    }
+
+    explicit ConcurrentSearchServer(const std::string& stop_words_text)
+        : ConcurrentSearchServer(std::string_view(stop_words_text)) {
+    }
+
+    explicit ConcurrentSearchServer(std::string_view stop_words_text)
+        : servers_{SearchServer(stop_words_text), SearchServer(stop_words_text)} {
+    }
+
+    // Вызывает function(const SearchServer&) для опубликованной версии индекса,
+    // которая не меняется, пока function работает
+    template <typename Function>
+    auto Read(Function function) const;
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const {
+        return Read([&args...](const SearchServer& search_server) {
+            return search_server.FindTopDocuments(args...);
+        });
+    }
+
+    int GetDocumentCount() const;
+
+    // Вызывает function(SearchServer&) для обеих копий индекса по очереди, так что function
+    // должна менять их одинаково. Если function выбросит исключение на первой копии,
+    // оно пробрасывается, а индекс остаётся прежним. Исключение на второй копии (например,
+    // bad_alloc) вызывает std::terminate: копии разошлись бы, и следующая запись опубликовала
+    // бы копию без уже видимого читателям изменения. Писатели выполняются по одному.
+    template <typename Function>
+    void Write(Function function);
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+
+    void AddDocuments(const std::vector<NewDocument>& documents);
+
+    void RemoveDocument(int document_id);
+
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t READER_SLOT_COUNT = 64;
+
+    // Число читателей копии индекса; поток всегда пользуется одним и тем же счётчиком
+    struct alignas(CACHE_LINE_SIZE) ReaderCounter {
+        std::atomic<int64_t> count = 0;
+    };
+
+    std::array<SearchServer, 2> servers_;
+    // номер опубликованной копии
+    std::atomic<int> active_ = 0;
+    mutable std::array<std::array<ReaderCounter, READER_SLOT_COUNT>, 2> readers_;
+    std::mutex writer_mutex_;
+
+    static size_t GetReaderSlot();
+
+    // Ждёт, пока копию index не покинут все читатели
+    void WaitForReaders(int index) const;
+};
+
+template <typename Function>
+auto ConcurrentSearchServer::Read(Function function) const {
+    std::atomic<int64_t>* counter = nullptr;
+    int index = 0;
+    const size_t slot = GetReaderSlot();
+    for (;;) {
+        index = active_.load(std::memory_order_seq_cst);
+        counter = &readers_[index][slot].count;
+        counter->fetch_add(1, std::memory_order_seq_cst);
+        // писатель мог опубликовать другую копию раньше, чем увидел этого читателя
+        if (active_.load(std::memory_order_seq_cst) == index) {
+            break;
+        }
+        counter->fetch_sub(1, std::memory_order_release);
+    }
+    struct ReaderGuard {
+        std::atomic<int64_t>* counter;
+
+        ~ReaderGuard() {
+            counter->fetch_sub(1, std::memory_order_release);
+        }
+    } guard{counter};
+    return function(servers_[index]);
+}
+
+template <typename Function>
+void ConcurrentSearchServer::Write(Function function) {
+    std::lock_guard lock(writer_mutex_);
+    const int active = active_.load(std::memory_order_relaxed);
+    const int inactive = 1 - active;
+    function(servers_[inactive]);
+    active_.store(inactive, std::memory_order_seq_cst);
+    WaitForReaders(active);
+    [&]() noexcept {
+        function(servers_[active]);
+    }();
+}
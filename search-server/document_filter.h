@@ -0,0 +1,19 @@
+#pragma once
+
+#include "document.h"
+
+#include <limits>
+#include <optional>
+#include <vector>
+
+// Фильтр документов для SearchServer::FindTopDocuments. В отличие от произвольного
+// предиката, его сервер разбирает сам: при узком фильтре перебираются только подходящие
+// документы, широкий проверяется по порядковому номеру прямо при обходе вхождений.
+struct DocumentFilter {
+    std::vector<DocumentStatus> statuses = {DocumentStatus::ACTUAL};
+    // рейтинг из отрезка [min_rating, max_rating]
+    int min_rating = std::numeric_limits<int>::min();
+    int max_rating = std::numeric_limits<int>::max();
+    // если задан, подходят только документы с этими id
+    std::optional<std::vector<int>> document_ids;
+};
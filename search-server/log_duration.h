@@ -1,7 +1,18 @@
 #pragma once
 
+#include "log_linear_bins.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
 #define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
@@ -36,4 +47,152 @@ private:
     const std::string id_ ;
     std::ostream& stream_ = std::cerr;
     const Clock::time_point start_time_ = Clock::now();
-};
\ No newline at end of file
+};
+
+struct DurationStats {
+    std::string name;
+    uint64_t count = 0;
+    std::chrono::nanoseconds total{0};
+    std::chrono::nanoseconds p50{0};
+    std::chrono::nanoseconds p99{0};
+    std::chrono::nanoseconds p999{0};
+};
+
+// Гистограмма длительностей в наносекундах с погрешностью не больше 1/16. У каждого
+// потока свой набор счётчиков (потоков больше, чем наборов, - набор делят несколько
+// потоков), запись - одно атомарное сложение без блокировок, при чтении наборы складываются.
+class DurationHistogram {
+public:
+    using Bins = LogLinearBins<16>;
+    // всё дольше 2^40 нс (около 18 минут) попадает в последнюю корзину
+    static constexpr size_t BIN_COUNT = Bins::GetBinCount(40);
+
+    explicit DurationHistogram(std::string name)
+        : name_(std::move(name))
+        , shards_(SHARD_COUNT) {
+    }
+
+    void Add(std::chrono::nanoseconds duration) {
+        Shard& shard = shards_[GetShard()];
+        const uint64_t value = std::max<int64_t>(duration.count(), 0);
+        shard.counts[std::min(Bins::GetBin(value), BIN_COUNT - 1)].fetch_add(1, std::memory_order_relaxed);
+        shard.total.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    DurationStats GetStats() const {
+        std::array<uint64_t, BIN_COUNT> counts{};
+        DurationStats stats;
+        stats.name = name_;
+        for (const Shard& shard : shards_) {
+            for (size_t bin = 0; bin < BIN_COUNT; ++bin) {
+                const uint64_t count = shard.counts[bin].load(std::memory_order_relaxed);
+                counts[bin] += count;
+                stats.count += count;
+            }
+            stats.total += std::chrono::nanoseconds(shard.total.load(std::memory_order_relaxed));
+        }
+        stats.p50 = std::chrono::nanoseconds(Bins::GetPercentile(counts, stats.count, 50.0));
+        stats.p99 = std::chrono::nanoseconds(Bins::GetPercentile(counts, stats.count, 99.0));
+        stats.p999 = std::chrono::nanoseconds(Bins::GetPercentile(counts, stats.count, 99.9));
+        return stats;
+    }
+
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        std::array<std::atomic<uint64_t>, BIN_COUNT> counts{};
+        std::atomic<uint64_t> total = 0;
+    };
+
+    std::string name_;
+    std::vector<Shard> shards_;
+
+    static size_t GetShard() {
+        // потоки получают наборы по кругу, чтобы соседние потоки не делили набор
+        static std::atomic<size_t> next_shard = 0;
+        static thread_local const size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+        return shard;
+    }
+};
+
+// Именованные гистограммы длительностей, общие для всей программы
+class DurationRegistry {
+public:
+    static DurationRegistry& Instance() {
+        static DurationRegistry registry;
+        return registry;
+    }
+
+    // Гистограмма с именем name; ссылка действительна до конца программы
+    DurationHistogram& Get(const std::string& name) {
+        std::lock_guard lock(mutex_);
+        auto& histogram = histograms_[name];
+        if (!histogram) {
+            histogram = std::make_unique<DurationHistogram>(name);
+        }
+        return *histogram;
+    }
+
+    // Статистика всех гистограмм, в которые что-то записано, по именам
+    std::vector<DurationStats> GetStats() const {
+        std::lock_guard lock(mutex_);
+        std::vector<DurationStats> result;
+        for (const auto& [name, histogram] : histograms_) {
+            DurationStats stats = histogram->GetStats();
+            if (stats.count > 0) {
+                result.push_back(std::move(stats));
+            }
+        }
+        return result;
+    }
+
+    void Print(std::ostream& out) const {
+        using namespace std::literals;
+        for (const DurationStats& stats : GetStats()) {
+            out << stats.name << ": count "s << stats.count
+                << ", total "s << std::chrono::duration_cast<std::chrono::microseconds>(stats.total).count() << " us"s
+                << ", p50 "s << stats.p50.count() << " ns"s
+                << ", p99 "s << stats.p99.count() << " ns"s
+                << ", p999 "s << stats.p999.count() << " ns"s << std::endl;
+        }
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<DurationHistogram>> histograms_;
+};
+
+// Записывает в гистограмму время жизни объекта
+class ScopedDuration {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ScopedDuration(DurationHistogram& histogram)
+        : histogram_(histogram) {
+    }
+
+    ScopedDuration(const ScopedDuration&) = delete;
+    ScopedDuration& operator=(const ScopedDuration&) = delete;
+
+    ~ScopedDuration() {
+        histogram_.Add(Clock::now() - start_time_);
+    }
+
+private:
+    DurationHistogram& histogram_;
+    const Clock::time_point start_time_ = Clock::now();
+};
+
+// PROFILE_DURATION(name) записывает время до конца блока в гистограмму name из
+// DurationRegistry. Гистограмма ищется по имени один раз на место вызова. Без
+// SEARCH_SERVER_PROFILE макрос пуст, и замеры не стоят ничего.
+#ifdef SEARCH_SERVER_PROFILE
+#define PROFILE_HISTOGRAM_NAME PROFILE_CONCAT(profileHistogram, __LINE__)
+#define PROFILE_DURATION(name) \
+    static DurationHistogram& PROFILE_HISTOGRAM_NAME = DurationRegistry::Instance().Get(name); \
+    ScopedDuration UNIQUE_VAR_NAME_PROFILE(PROFILE_HISTOGRAM_NAME)
+#else
+#define PROFILE_DURATION(name)
+#endif
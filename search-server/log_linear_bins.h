@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Логарифмически-линейная гистограмма: значения меньше SubBinCount лежат каждое в своей
+// корзине, дальше на каждую степень двойки приходится SubBinCount корзин одной ширины,
+// так что ширина корзины не больше 1/SubBinCount от её значений. SubBinCount - степень двойки.
+template <uint64_t SubBinCount>
+struct LogLinearBins {
+    static_assert(SubBinCount >= 2 && (SubBinCount & (SubBinCount - 1)) == 0);
+
+    static constexpr int SUB_BIN_BITS = __builtin_ctzll(SubBinCount);
+
+    // Сколько корзин нужно, чтобы различать значения меньше 2^power_count
+    static constexpr size_t GetBinCount(int power_count) {
+        return (power_count - SUB_BIN_BITS + 1) * SubBinCount;
+    }
+
+    static size_t GetBin(uint64_t value) {
+        if (value < SubBinCount) {
+            return value;
+        }
+        // старшая степень двойки и SUB_BIN_BITS следующих за ней битов
+        const int power = 63 - __builtin_clzll(value);
+        const uint64_t sub_bin = value >> (power - SUB_BIN_BITS) & (SubBinCount - 1);
+        return (power - SUB_BIN_BITS + 1) * SubBinCount + sub_bin;
+    }
+
+    static uint64_t GetUpperBound(size_t bin) {
+        if (bin < SubBinCount) {
+            return bin;
+        }
+        const int power = bin / SubBinCount + SUB_BIN_BITS - 1;
+        const uint64_t sub_bin = bin % SubBinCount;
+        return ((SubBinCount + sub_bin + 1) << (power - SUB_BIN_BITS)) - 1;
+    }
+
+    // Верхняя граница корзины, до которой включительно лежат percentile процентов значений;
+    // counts - числа значений по корзинам, total - их сумма
+    template <typename Counts>
+    static uint64_t GetPercentile(const Counts& counts, uint64_t total, double percentile) {
+        if (total == 0) {
+            return 0;
+        }
+        const uint64_t rank = std::max<uint64_t>(1, std::ceil(percentile / 100.0 * total));
+        uint64_t count = 0;
+        for (size_t bin = 0; bin < counts.size(); ++bin) {
+            count += counts[bin];
+            if (count >= rank) {
+                return GetUpperBound(bin);
+            }
+        }
+        return GetUpperBound(counts.size() - 1);
+    }
+};
@@ -1,15 +1,34 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <fstream>
+#include <functional>
 #include <future>
+#include <iterator>
 #include <map>
+#include <mutex>
 #include <numeric>
+#include <optional>
 #include <random>
+#include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "concurrent_map.h"
+#include "concurrent_search_server.h"
+#include "ordinal_set.h"
+#include "posting_list.h"
 #include "search_server.h"
+#include "segment.h"
+#include "string_processing.h"
 #include "process_queries.h"
+#include "remove_duplicates.h"
+#include "query_statistics.h"
+#include "request_queue.h"
 
 #include "log_duration.h"
 #include "test_framework.h"
@@ -19,6 +38,26 @@
 
 using namespace std;
 
+// Выделения памяти текущего потока через operator new, см. TestQueryContextAllocations
+thread_local size_t allocation_count = 0;
+
+// Замещающие операторы не встраиваются, иначе компилятор видит free для памяти от new
+[[gnu::noinline]] void* operator new(size_t size) {
+    ++allocation_count;
+    if (void* data = malloc(size == 0 ? 1 : size)) {
+        return data;
+    }
+    throw bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* data) noexcept {
+    free(data);
+}
+
+[[gnu::noinline]] void operator delete(void* data, size_t) noexcept {
+    free(data);
+}
+
 void RunConcurrentUpdates(ConcurrentMap<int, int>& cm, size_t thread_count, int key_count) {
     auto kernel = [&cm, key_count](int seed) {
         vector<int> updates(key_count);
@@ -84,24 +123,1774 @@ void TestReadAndWrite() {
     }
 }
 
+void TestConcurrentErase() {
+    constexpr int KEY_COUNT = 50000;
+
+    ConcurrentMap<int, int> cm(16);
+    for (int key = 0; key < KEY_COUNT; ++key) {
+        cm[key].ref_to_value = 1;
+    }
+
+    auto eraser = [&cm] {
+        for (int key = 0; key < KEY_COUNT; key += 2) {
+            cm.Erase(key);
+        }
+    };
+    auto updater = [&cm] {
+        for (int key = 1; key < KEY_COUNT; key += 2) {
+            cm[key] += 1;
+        }
+    };
+
+    vector<future<void>> futures;
+    for (int i = 0; i < 2; ++i) {
+        futures.push_back(async(launch::async, eraser));
+        futures.push_back(async(launch::async, updater));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+
+    const auto result = cm.BuildVector();
+    ASSERT_EQUAL(result.size(), static_cast<size_t>(KEY_COUNT / 2));
+    for (auto& [k, v] : result) {
+        AssertEqual(k % 2, 1, "Key = " + to_string(k));
+        AssertEqual(v, 3, "Key = " + to_string(k));
+    }
+    ASSERT(!cm.Find(0).has_value());
+    ASSERT_EQUAL(cm.Find(1).value_or(0), 3);
+}
+
+// Читатели и писатели конкурируют за одни и те же корзины
+void RunConcurrentReadsAndUpdates(ConcurrentMap<int, int>& cm, size_t thread_count, int key_count) {
+    auto reader = [&cm, key_count] {
+        int found = 0;
+        for (int key = 0; key < key_count; ++key) {
+            found += cm.Find(key).has_value();
+        }
+        return found;
+    };
+
+    vector<future<int>> readers;
+    for (size_t i = 0; i < thread_count; ++i) {
+        readers.push_back(async(launch::async, reader));
+    }
+    RunConcurrentUpdates(cm, thread_count, key_count);
+    for (auto& f : readers) {
+        f.get();
+    }
+}
+
 void TestSpeedup() {
+    for (size_t thread_count : {1, 2, 4, 8}) {
+        for (size_t bucket_count : {1, 16, 128}) {
+            const string mark = "threads: "s + to_string(thread_count) + ", buckets: "s + to_string(bucket_count);
+            {
+                ConcurrentMap<int, int> cm(bucket_count);
+                LOG_DURATION("updates, "s + mark);
+                RunConcurrentUpdates(cm, thread_count, 50000);
+            }
+            {
+                ConcurrentMap<int, int> cm(bucket_count);
+                LOG_DURATION("reads and updates, "s + mark);
+                RunConcurrentReadsAndUpdates(cm, thread_count, 50000);
+            }
+        }
+    }
+}
+
+// Прежняя реализация разбиения со второй проверкой символов, для сравнения
+bool SplitIntoWordsByFind(string_view text, vector<string_view>& words) {
+    words.clear();
+    text.remove_prefix(min(text.size(), text.find_first_not_of(' ')));
+    while (!text.empty()) {
+        const auto space = text.find(' ');
+        words.push_back(text.substr(0, space));
+        text.remove_prefix(min(text.size(), text.find_first_not_of(' ', space)));
+    }
+    return all_of(words.begin(), words.end(), [](string_view word) {
+        return none_of(word.begin(), word.end(), [](char c) { return c >= '\0' && c < ' '; });
+    });
+}
+
+void TestSplitIntoWords() {
+    mt19937 generator;
+    const string alphabet = "  ab-z\x01\x1f\x7f\xd0\x80"s;
+    vector<string_view> expected;
+    vector<string_view> words;
+    for (int i = 0; i < 10'000; ++i) {
+        string text(uniform_int_distribution(0, 100)(generator), ' ');
+        for (char& c : text) {
+            c = alphabet[uniform_int_distribution<size_t>(0, alphabet.size() - 1)(generator)];
+        }
+        const bool expected_valid = SplitIntoWordsByFind(text, expected);
+        ASSERT_EQUAL(SplitIntoWords(text, words), expected_valid);
+        ASSERT(words == expected);
+        ASSERT_EQUAL(SplitIntoWordsScalar(text, words), expected_valid);
+        ASSERT(words == expected);
+    }
+    ASSERT(SplitIntoWords(string_view(""), words) && words.empty());
+    ASSERT(SplitIntoWords("   "sv, words) && words.empty());
+    ASSERT(SplitIntoWords("  cat   and dog"sv, words) && words == vector<string_view>({"cat"sv, "and"sv, "dog"sv}));
+    ASSERT(!SplitIntoWords("cat d\x12og"sv, words));
+}
+
+void TestPostingList() {
+    PostingList postings;
+    map<int, double> expected;
+    mt19937 generator(7);
+    for (int i = 0; i < 5000; ++i) {
+        const int document_id = uniform_int_distribution<int>(0, 999)(generator);
+        if (expected.count(document_id)) {
+            postings.Remove(document_id);
+            expected.erase(document_id);
+        } else {
+            postings.Add({document_id, static_cast<uint32_t>(document_id), static_cast<double>(i)});
+            expected[document_id] = i;
+        }
+        if (i % 1000 == 0) {
+            postings.Merge();
+        }
+    }
+
+    vector<pair<int, double>> actual;
+    postings.ForEach([&actual](const Posting& posting) {
+        actual.push_back({posting.document_id, posting.term_freq});
+    });
+    ASSERT_EQUAL(postings.size(), expected.size());
+    const vector<pair<int, double>> expected_postings(expected.begin(), expected.end());
+    ASSERT(actual == expected_postings);
+    for (int document_id = 0; document_id < 1000; ++document_id) {
+        ASSERT_EQUAL(postings.Contains(document_id), expected.count(document_id) > 0);
+    }
+
+    // маленький пакет удаляется через дельту, большой - перестройкой списка
+    for (const int step : {97, 3}) {
+        vector<int> removed;
+        for (int document_id = 0; document_id < 1000; document_id += step) {
+            removed.push_back(document_id);
+            expected.erase(document_id);
+        }
+        postings.RemoveSorted(removed);
+        ASSERT_EQUAL(postings.size(), expected.size());
+        for (int document_id = 0; document_id < 1000; ++document_id) {
+            ASSERT_EQUAL(postings.Contains(document_id), expected.count(document_id) > 0);
+        }
+    }
+}
+
+void TestSegment() {
+    // разреженные и плотные слова, разрывы номеров на всю ширину uint32_t
+    mt19937 generator(11);
+    map<TermId, map<uint32_t, double>> expected;
+    for (TermId term = 0; term < 50; ++term) {
+        const int count = term % 5 == 0 ? 1000 : uniform_int_distribution<int>(1, 30)(generator);
+        for (int i = 0; i < count; ++i) {
+            const uint32_t ordinal = term == 7 && i == 0 ? numeric_limits<uint32_t>::max()
+                                                         : uniform_int_distribution<uint32_t>(0, 5000)(generator);
+            expected[term][ordinal] = 1.0 / uniform_int_distribution<int>(1, 300)(generator);
+        }
+    }
+    SegmentBuilder builder;
+    set<uint32_t> ordinal_set;
+    for (const auto& [term, postings] : expected) {
+        for (const auto& [ordinal, term_freq] : postings) {
+            builder.Add(term, ordinal, term_freq);
+            ordinal_set.insert(ordinal);
+        }
+    }
+    const auto segment = builder.Build(vector<uint32_t>(ordinal_set.begin(), ordinal_set.end()));
+
+    size_t posting_count = 0;
+    for (TermId term = 0; term < 51; ++term) {
+        const auto& postings = expected[term];
+        posting_count += postings.size();
+        vector<pair<uint32_t, double>> actual;
+        segment->ForEach(term, 1000, 3000, [&actual](uint32_t ordinal, double term_freq) {
+            actual.push_back({ordinal, term_freq});
+        });
+        const vector<pair<uint32_t, double>> expected_postings(postings.lower_bound(1000), postings.upper_bound(3000));
+        ASSERT(actual == expected_postings);
+        for (uint32_t ordinal = 0; ordinal <= 5000; ordinal += 7) {
+            ASSERT_EQUAL(segment->Contains(term, ordinal), postings.count(ordinal) > 0);
+        }
+        ASSERT(segment->EstimatePostingCount(term) >= postings.size());
+    }
+    ASSERT(segment->Contains(7, numeric_limits<uint32_t>::max()));
+    for (TermId term = 0; term < 51; ++term) {
+        const auto& postings = expected[term];
+        Segment::Cursor cursor(*segment, term, 100, 4000);
+        for (uint32_t ordinal = 100; ordinal <= 4000 && cursor.GetOrdinal() != Segment::Cursor::END; ordinal += 37) {
+            // курсор не возвращается назад, если уже прошёл ordinal
+            const auto it = postings.lower_bound(max(ordinal, static_cast<uint32_t>(cursor.GetOrdinal())));
+            ASSERT(cursor.GetBlockMaxTermFreq(ordinal) >= (it != postings.end() && it->first == ordinal ? it->second : 0.0));
+            cursor.SeekTo(ordinal);
+            if (it == postings.end() || it->first > 4000) {
+                ASSERT_EQUAL(cursor.GetOrdinal(), Segment::Cursor::END);
+                break;
+            }
+            ASSERT_EQUAL(cursor.GetOrdinal(), uint64_t{it->first});
+            ASSERT_EQUAL(cursor.GetTermFreq(), it->second);
+            ASSERT(cursor.GetTermFreq() <= cursor.GetMaxTermFreq());
+            cursor.Next();
+            const auto next = std::next(it);
+            ASSERT_EQUAL(cursor.GetOrdinal(), next == postings.end() || next->first > 4000 ? Segment::Cursor::END
+                                                                                            : uint64_t{next->first});
+        }
+    }
+    ASSERT_EQUAL(segment->GetPostingCount(), posting_count);
+
+    // слияние выбрасывает чётные номера и сдвигает остальные
+    const auto merged = Segment::Merge({segment, SegmentBuilder().Build({})}, [](uint32_t ordinal) { return ordinal % 2 == 0; },
+                                       [](uint32_t ordinal) { return ordinal / 2; });
+    for (const auto& [term, postings] : expected) {
+        vector<pair<uint32_t, double>> actual;
+        merged->ForEach(term, 0, numeric_limits<uint32_t>::max(), [&actual](uint32_t ordinal, double term_freq) {
+            actual.push_back({ordinal, term_freq});
+        });
+        vector<pair<uint32_t, double>> expected_postings;
+        for (const auto& [ordinal, term_freq] : postings) {
+            if (ordinal % 2 != 0) {
+                expected_postings.push_back({ordinal / 2, term_freq});
+            }
+        }
+        ASSERT(actual == expected_postings);
+    }
+}
+
+void TestOrdinalSet() {
+    OrdinalSet ordinals;
+    ordinals.Reset(1000);
+    ASSERT(ordinals.empty());
+    for (uint32_t ordinal : {0u, 63u, 64u, 999u}) {
+        ordinals.Insert(ordinal);
+    }
+    ASSERT(!ordinals.empty());
+    for (uint32_t ordinal = 0; ordinal < 1000; ++ordinal) {
+        ASSERT_EQUAL(ordinals.Contains(ordinal), ordinal == 0 || ordinal == 63 || ordinal == 64 || ordinal == 999);
+    }
+    // после Reset множество пусто, даже если стало больше
+    ordinals.Reset(5000);
+    ASSERT(ordinals.empty());
+    for (uint32_t ordinal = 0; ordinal < 5000; ++ordinal) {
+        ASSERT(!ordinals.Contains(ordinal));
+    }
+}
+
+void TestMaxResultDocumentCount() {
+    SearchServer search_server("and with"s);
+    for (int id = 0; id < 20; ++id) {
+        search_server.AddDocument(id, "white cat "s + (id % 2 ? "and fluffy tail"s : "with collar"s), DocumentStatus::ACTUAL, {id % 7});
+    }
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+
+    search_server.SetMaxResultDocumentCount(12);
+    const auto documents = search_server.FindTopDocuments(execution::par, "fluffy cat"s);
+    ASSERT_EQUAL(documents.size(), 12u);
+    ASSERT(is_sorted(documents.begin(), documents.end(), IsMoreRelevant));
+    for (size_t i = 0; i < 10; ++i) {
+        ASSERT_EQUAL(documents[i].id % 2, 1);
+    }
+
+    search_server.SetMaxResultDocumentCount(0);
+    ASSERT(search_server.FindTopDocuments("cat"s).empty());
+}
+
+void TestInverseDocumentFreqRefresh() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "dog"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(abs(search_server.FindTopDocuments("cat"s).at(0).relevance - log(2.0)) < 1e-12);
+
+    search_server.AddDocument(3, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    const auto documents = search_server.FindTopDocuments(execution::par, "cat"s);
+    ASSERT_EQUAL(documents.size(), 2u);
+    ASSERT(abs(documents[0].relevance - log(1.5)) < 1e-12);
+    ASSERT(abs(documents[1].relevance - 0.5 * log(1.5)) < 1e-12);
+
+    search_server.RemoveDocument(3);
+    ASSERT(abs(search_server.FindTopDocuments("cat"s).at(0).relevance - log(2.0)) < 1e-12);
+}
+
+void TestQueryContextAllocations() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, {8, -3});
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, {5, -12, 2, 1});
+    search_server.AddDocument(4, "groomed starling evgeny"s, DocumentStatus::ACTUAL, {9});
+    const vector<string> queries = {"fluffy cat -collar"s, "groomed dog dog expressive eyes evgeny"s,
+                                    "cat with and"s, "parrot"s, "-cat"s, ""s};
+
+    QueryContext context;
+    auto run_queries = [&] {
+        int checksum = 0;
+        for (const string& query : queries) {
+            for (const Document& document : search_server.FindTopDocuments(context, query)) {
+                checksum += document.id;
+            }
+            for (const Document& document : search_server.FindTopDocuments(context, query, DocumentStatus::BANNED)) {
+                checksum += document.id;
+            }
+            const auto& documents = search_server.FindTopDocuments(context, query,
+                [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; });
+            checksum += documents.size();
+        }
+        return checksum;
+    };
+    // прогрев: буферы контекста и потока дорастают до нужного размера
+    const int expected_checksum = run_queries();
+    const size_t allocations_before = allocation_count;
+    const int checksum = run_queries();
+    const size_t allocations = allocation_count - allocations_before;
+    ASSERT_EQUAL(checksum, expected_checksum);
+    ASSERT_EQUAL(allocations, 0u);
+
+    for (const string& query : queries) {
+        const vector<Document> documents = search_server.FindTopDocuments(context, query);
+        const auto expected_documents = search_server.FindTopDocuments(query);
+        ASSERT_EQUAL(documents.size(), expected_documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL(documents[i].id, expected_documents[i].id);
+            ASSERT_EQUAL(documents[i].relevance, expected_documents[i].relevance);
+        }
+    }
+}
+
+void TestQueryCache() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, {8, -3});
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, {5, -12, 2, 1});
+    search_server.SetQueryCacheCapacity(100);
+
+    auto ids = [](const vector<Document>& documents) {
+        vector<int> result;
+        for (const Document& document : documents) {
+            result.push_back(document.id);
+        }
+        return result;
+    };
+    auto assert_stats = [&search_server](uint64_t hits, uint64_t misses) {
+        const QueryCacheStats stats = search_server.GetQueryCacheStats();
+        ASSERT_EQUAL(stats.hits, hits);
+        ASSERT_EQUAL(stats.misses, misses);
+    };
+
+    ASSERT(ids(search_server.FindTopDocuments("cat dog"s)) == vector<int>({2, 1}));
+    assert_stats(0, 1);
+    // запрос нормализуется: порядок и повторы слов, стоп-слова не важны
+    ASSERT(ids(search_server.FindTopDocuments("dog with cat cat"s)) == vector<int>({2, 1}));
+    assert_stats(1, 1);
+    ASSERT(ids(search_server.FindTopDocuments(execution::par, "cat dog"s, DocumentStatus::BANNED)) == vector<int>({3}));
+    assert_stats(1, 2);
+    ASSERT(ids(search_server.FindTopDocuments("cat -dog"s)) == vector<int>({2, 1}));
+    assert_stats(1, 3);
+
+    // изменение индекса делает записи недействительными
+    search_server.AddDocument(4, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(ids(search_server.FindTopDocuments("cat dog"s)) == vector<int>({4, 2, 1}));
+    assert_stats(1, 4);
+    search_server.RemoveDocument(2);
+    ASSERT(ids(search_server.FindTopDocuments("cat dog"s)) == vector<int>({4, 1}));
+    assert_stats(1, 5);
+    search_server.SetMaxResultDocumentCount(1);
+    ASSERT(ids(search_server.FindTopDocuments("cat dog"s)) == vector<int>({4}));
+    assert_stats(1, 6);
+
+    QueryContext context;
+    ASSERT(ids(search_server.FindTopDocuments(context, "dog cat"s)) == vector<int>({4}));
+    assert_stats(2, 6);
+    // запросы с предикатом кэш не используют
+    search_server.FindTopDocuments("cat"s, [](int, DocumentStatus, int) { return true; });
+    assert_stats(2, 6);
+
+    search_server.SetMaxResultDocumentCount(MAX_RESULT_DOCUMENT_COUNT);
+    const vector<string> queries = {"cat"s, "dog"s, "cat dog"s, "fluffy -collar"s, "eyes"s, "cat"s, "dog"s};
+    auto process_queries = [&] {
+        vector<vector<int>> result;
+        for (const auto& documents : ProcessQueries(search_server, queries)) {
+            result.push_back(ids(documents));
+        }
+        return result;
+    };
+    const auto expected = process_queries();
+    const uint64_t calls = search_server.GetQueryCacheStats().hits + search_server.GetQueryCacheStats().misses;
+    ASSERT(process_queries() == expected);
+    // повторы запросов в пакете считаются один раз
+    constexpr size_t DISTINCT_QUERY_COUNT = 5;
+    const QueryCacheStats stats = search_server.GetQueryCacheStats();
+    ASSERT_EQUAL(stats.hits + stats.misses, calls + DISTINCT_QUERY_COUNT);
+    ASSERT(stats.hits >= 2 + DISTINCT_QUERY_COUNT);
+
+    search_server.SetQueryCacheCapacity(0);
+    assert_stats(0, 0);
+    ASSERT(process_queries() == expected);
+}
+
+void TestConcurrentSearchServer() {
+    constexpr int PAIR_COUNT = 2'000;
+    ConcurrentSearchServer search_server("and"s);
+    atomic<bool> writer_done = false;
+
+    // писатель добавляет документы парами и удаляет старые пары,
+    // читатели никогда не должны увидеть половину пары
+    auto writer = async(launch::async, [&] {
+        for (int pair = 0; pair < PAIR_COUNT; ++pair) {
+            const string pair_word = "pair"s + to_string(pair);
+            const string first = "common "s + pair_word + " left"s;
+            const string second = "common "s + pair_word + " right"s;
+            search_server.AddDocuments({{2 * pair, first, DocumentStatus::ACTUAL, {1}},
+                                        {2 * pair + 1, second, DocumentStatus::ACTUAL, {2}}});
+            if (pair >= 10 && pair % 2 == 0) {
+                search_server.Write([pair](SearchServer& server) {
+                    server.RemoveDocument(2 * (pair - 10));
+                    server.RemoveDocument(2 * (pair - 10) + 1);
+                });
+            }
+        }
+        writer_done = true;
+    });
+
+    vector<future<int>> readers;
+    for (int reader = 0; reader < 3; ++reader) {
+        readers.push_back(async(launch::async, [&, reader] {
+            mt19937 generator(reader);
+            int checks = 0;
+            while (!writer_done || checks < 100) {
+                const int pair = uniform_int_distribution(0, PAIR_COUNT - 1)(generator);
+                const size_t found = search_server.FindTopDocuments("pair"s + to_string(pair)).size();
+                ASSERT(found == 0 || found == 2);
+                search_server.Read([](const SearchServer& server) {
+                    ASSERT_EQUAL(server.GetDocumentCount() % 2, 0);
+                    const size_t common_count = server.FindTopDocuments(execution::par, "common"s).size();
+                    ASSERT_EQUAL(common_count, min<size_t>(server.GetDocumentCount(), MAX_RESULT_DOCUMENT_COUNT));
+                });
+                ++checks;
+            }
+            return checks;
+        }));
+    }
+    writer.get();
+    for (auto& reader : readers) {
+        ASSERT(reader.get() >= 100);
+    }
+    // обе копии индекса пришли в одно состояние
+    const int removed_pairs = (PAIR_COUNT - 1 - 10) / 2 + 1;
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 2 * (PAIR_COUNT - removed_pairs));
+    for (int i = 0; i < 2; ++i) {
+        search_server.AddDocument(-1 - i + 2 * PAIR_COUNT + 10, "probe"s, DocumentStatus::ACTUAL, {1});
+        ASSERT_EQUAL(search_server.FindTopDocuments("pair10 pair1999 probe"s).size(), 3u + i);
+    }
+    try {
+        search_server.AddDocument(0, "pair0 x\x12"s, DocumentStatus::ACTUAL, {1});
+        ASSERT(false);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT(search_server.FindTopDocuments("pair0"s).empty());
+}
+
+void TestAddDocuments() {
+    const vector<string> texts = {"white cat and fashionable collar"s, "fluffy cat fluffy tail"s,
+                                  "groomed dog expressive eyes"s, "groomed starling evgeny"s, "cat"s};
+    vector<NewDocument> documents;
+    SearchServer expected("and in on"s);
+    for (int i = 0; i < static_cast<int>(texts.size()); ++i) {
+        documents.push_back({i * 3, texts[i], static_cast<DocumentStatus>(i % 2), {i, 2 * i, 7}});
+        expected.AddDocument(i * 3, texts[i], static_cast<DocumentStatus>(i % 2), {i, 2 * i, 7});
+    }
+
+    SearchServer search_server("and in on"s);
+    search_server.AddDocument(100, "cat with collar"s, DocumentStatus::ACTUAL, {1});
+    expected.AddDocument(100, "cat with collar"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocuments(execution::par, documents);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), expected.GetDocumentCount());
+    for (const string& query : {"fluffy groomed cat"s, "cat -collar"s, "evgeny eyes"s}) {
+        for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT}) {
+            const auto actual_documents = search_server.FindTopDocuments(query, status);
+            const auto expected_documents = expected.FindTopDocuments(query, status);
+            ASSERT_EQUAL(actual_documents.size(), expected_documents.size());
+            for (size_t i = 0; i < actual_documents.size(); ++i) {
+                ASSERT_EQUAL(actual_documents[i].id, expected_documents[i].id);
+                ASSERT_EQUAL(actual_documents[i].relevance, expected_documents[i].relevance);
+                ASSERT_EQUAL(actual_documents[i].rating, expected_documents[i].rating);
+            }
+        }
+    }
+    for (const int document_id : expected) {
+        ASSERT(search_server.GetWordFrequencies(document_id) == expected.GetWordFrequencies(document_id));
+    }
+
+    auto assert_rejected = [&search_server](const vector<NewDocument>& batch) {
+        const int document_count = search_server.GetDocumentCount();
+        try {
+            search_server.AddDocuments(execution::par, batch);
+            ASSERT(false);
+        } catch (const invalid_argument&) {
+        }
+        ASSERT_EQUAL(search_server.GetDocumentCount(), document_count);
+        ASSERT(search_server.FindTopDocuments("parrot"s).empty());
+    };
+    assert_rejected({{200, "parrot"s, DocumentStatus::ACTUAL, {1}}, {200, "parrot"s, DocumentStatus::ACTUAL, {1}}});
+    assert_rejected({{201, "parrot"s, DocumentStatus::ACTUAL, {1}}, {3, "parrot"s, DocumentStatus::ACTUAL, {1}}});
+    assert_rejected({{202, "parrot"s, DocumentStatus::ACTUAL, {1}}, {-1, "parrot"s, DocumentStatus::ACTUAL, {1}}});
+    assert_rejected({{203, "parrot"s, DocumentStatus::ACTUAL, {1}}, {204, "par\x12rot"s, DocumentStatus::ACTUAL, {1}}});
+}
+
+void TestSnapshot() {
+    const string path = "search_server_test.snapshot"s;
+    SearchServer search_server("and with"s);
+    search_server.SetMaxResultDocumentCount(3);
+    search_server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, {8, -3});
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, {5, -12, 2, 1});
+    search_server.AddDocument(4, "groomed starling evgeny"s, DocumentStatus::IRRELEVANT, {9});
+    search_server.AddDocument(5, "cat with collar"s, DocumentStatus::ACTUAL, {1});
+    search_server.RemoveDocument(4);
+    search_server.SaveSnapshot(path);
+
+    // одинаковый индекс записывается одинаковыми байтами
+    const string copy_path = path + ".copy"s;
+    search_server.SaveSnapshot(copy_path);
+    auto read_file = [](const string& file_path) {
+        ifstream in(file_path, ios::binary);
+        return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    };
+    ASSERT(read_file(path) == read_file(copy_path));
+    remove(copy_path.c_str());
+
+    SearchServer loaded = SearchServer::LoadSnapshot(path);
+    auto assert_same = [](const SearchServer& lhs, const SearchServer& rhs) {
+        ASSERT_EQUAL(lhs.GetDocumentCount(), rhs.GetDocumentCount());
+        ASSERT_EQUAL(lhs.GetMaxResultDocumentCount(), rhs.GetMaxResultDocumentCount());
+        ASSERT(equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end()));
+        for (const string& query : {"fluffy groomed cat"s, "cat -collar"s, "evgeny eyes with"s}) {
+            for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED, DocumentStatus::IRRELEVANT}) {
+                const auto lhs_documents = lhs.FindTopDocuments(query, status);
+                const auto rhs_documents = rhs.FindTopDocuments(execution::par, query, status);
+                ASSERT_EQUAL(lhs_documents.size(), rhs_documents.size());
+                for (size_t i = 0; i < lhs_documents.size(); ++i) {
+                    ASSERT_EQUAL(lhs_documents[i].id, rhs_documents[i].id);
+                    ASSERT_EQUAL(lhs_documents[i].relevance, rhs_documents[i].relevance);
+                    ASSERT_EQUAL(lhs_documents[i].rating, rhs_documents[i].rating);
+                }
+            }
+            for (const int document_id : lhs) {
+                ASSERT(lhs.MatchDocument(query, document_id) == rhs.MatchDocument(query, document_id));
+            }
+        }
+        for (const int document_id : lhs) {
+            ASSERT(lhs.GetWordFrequencies(document_id) == rhs.GetWordFrequencies(document_id));
+        }
+    };
+    assert_same(search_server, loaded);
+
+    // загруженный сервер изменяется так же, как исходный
+    for (SearchServer* server : {&search_server, &loaded}) {
+        server->AddDocument(4, "groomed cat evgeny"s, DocumentStatus::ACTUAL, {3});
+        server->AddDocument(6, "fluffy starling"s, DocumentStatus::ACTUAL, {4});
+        server->RemoveDocument(2);
+        server->RemoveDocument(execution::par, 5);
+    }
+    assert_same(search_server, loaded);
+    loaded.Compact();
+    assert_same(search_server, loaded);
+
     {
-        ConcurrentMap<int, int> single_lock(1);
+        ofstream out(path, ios::binary | ios::trunc);
+        out << "not a snapshot"s;
+    }
+    try {
+        SearchServer::LoadSnapshot(path);
+        ASSERT(false);
+    } catch (const runtime_error&) {
+    }
+    remove(path.c_str());
+}
+
+void TestSnapshotSavedOverSource() {
+    const string path = "search_server_resave.snapshot"s;
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, {8, -3});
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, {5, -12, 2, 1});
+    search_server.SaveSnapshot(path);
+
+    // сегмент загруженного сервера отображён из того же файла, в который он сохраняется
+    SearchServer loaded = SearchServer::LoadSnapshot(path);
+    loaded.AddDocument(4, "groomed cat evgeny"s, DocumentStatus::ACTUAL, {3});
+    loaded.SaveSnapshot(path);
+    search_server.AddDocument(4, "groomed cat evgeny"s, DocumentStatus::ACTUAL, {3});
+
+    SearchServer reloaded = SearchServer::LoadSnapshot(path);
+    for (SearchServer* server : {&loaded, &reloaded}) {
+        ASSERT_EQUAL(server->GetDocumentCount(), search_server.GetDocumentCount());
+        for (const string& query : {"fluffy groomed cat"s, "cat -collar"s, "evgeny eyes"s}) {
+            const auto expected = search_server.FindTopDocuments(query);
+            const auto actual = server->FindTopDocuments(query);
+            ASSERT_EQUAL(actual.size(), expected.size());
+            for (size_t i = 0; i < actual.size(); ++i) {
+                ASSERT_EQUAL(actual[i].id, expected[i].id);
+                ASSERT_EQUAL(actual[i].relevance, expected[i].relevance);
+            }
+        }
+    }
+    ifstream temp(path + ".tmp"s);
+    ASSERT(!temp);
+    remove(path.c_str());
+}
+
+void TestSegments() {
+    const vector<string> words = {"cat"s, "dog"s, "white"s, "fluffy"s, "tail"s, "collar"s, "eyes"s,
+                                  "groomed"s, "starling"s, "evgeny"s, "parrot"s, "and"s};
+    mt19937 generator(15);
+    auto generate_text = [&]() {
+        string text;
+        for (int i = uniform_int_distribution(1, 6)(generator); i > 0; --i) {
+            text += words[uniform_int_distribution<size_t>(0, words.size() - 1)(generator)] + " "s;
+        }
+        return text;
+    };
+    auto assert_same = [](const SearchServer& lhs, const SearchServer& rhs) {
+        ASSERT_EQUAL(lhs.GetDocumentCount(), rhs.GetDocumentCount());
+        ASSERT_EQUAL(lhs.GetMemoryUsage().posting_count, rhs.GetMemoryUsage().posting_count);
+        for (const string& query : {"fluffy groomed cat"s, "cat -collar"s, "evgeny eyes -white -dog"s, "parrot tail"s}) {
+            for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                const auto expected = lhs.FindTopDocuments(query, status);
+                for (const auto& actual : {rhs.FindTopDocuments(query, status),
+                                           rhs.FindTopDocuments(execution::par, query, status)}) {
+                    ASSERT_EQUAL(actual.size(), expected.size());
+                    for (size_t i = 0; i < actual.size(); ++i) {
+                        ASSERT_EQUAL(actual[i].id, expected[i].id);
+                        ASSERT_EQUAL(actual[i].relevance, expected[i].relevance);
+                    }
+                }
+            }
+            for (const int document_id : lhs) {
+                ASSERT(lhs.MatchDocument(query, document_id) == rhs.MatchDocument(query, document_id));
+            }
+        }
+    };
+
+    // в expected все документы в одном изменяемом сегменте, в search_server - во многих
+    SearchServer expected("and"s);
+    SearchServer search_server("and"s);
+    search_server.SetSegmentDocumentCount(8);
+    vector<int> document_ids;
+    for (int round = 0; round < 5; ++round) {
+        for (int i = 0; i < 50; ++i) {
+            const int document_id = round * 100 + i;
+            const string text = generate_text();
+            const auto status = static_cast<DocumentStatus>(i % 3 == 0);
+            expected.AddDocument(document_id, text, status, {i});
+            search_server.AddDocument(document_id, text, status, {i});
+            document_ids.push_back(document_id);
+        }
+        vector<string> texts;
+        vector<NewDocument> batch;
+        for (int i = 0; i < 20; ++i) {
+            texts.push_back(generate_text());
+        }
+        for (int i = 0; i < 20; ++i) {
+            batch.push_back({round * 100 + 50 + i, texts[i], DocumentStatus::ACTUAL, {i}});
+            document_ids.push_back(round * 100 + 50 + i);
+        }
+        expected.AddDocuments(batch);
+        search_server.AddDocuments(execution::par, batch);
+
+        shuffle(document_ids.begin(), document_ids.end(), generator);
+        for (int i = 0; i < 25; ++i) {
+            expected.RemoveDocument(document_ids.back());
+            if (i % 2 == 0) {
+                search_server.RemoveDocument(document_ids.back());
+            } else {
+                search_server.RemoveDocument(execution::par, document_ids.back());
+            }
+            document_ids.pop_back();
+        }
+        assert_same(expected, search_server);
+    }
+
+    const string path = "search_server_segments.snapshot"s;
+    search_server.SaveSnapshot(path);
+    assert_same(expected, SearchServer::LoadSnapshot(path));
+    remove(path.c_str());
+
+    search_server.Compact();
+    assert_same(expected, search_server);
+    const MemoryUsage usage = search_server.GetMemoryUsage();
+    for (const int document_id : document_ids) {
+        expected.RemoveDocument(document_id);
+        search_server.RemoveDocument(execution::par, document_id);
+    }
+    search_server.Compact();
+    assert_same(expected, search_server);
+    ASSERT(search_server.GetMemoryUsage().Total() < usage.Total());
+}
+
+void TestRemoveDocuments() {
+    const vector<string> words = {"cat"s, "dog"s, "white"s, "fluffy"s, "tail"s, "collar"s, "eyes"s,
+                                  "groomed"s, "starling"s, "evgeny"s, "parrot"s, "and"s};
+    mt19937 generator(21);
+    auto generate_text = [&]() {
+        string text;
+        for (int i = uniform_int_distribution(1, 6)(generator); i > 0; --i) {
+            text += words[uniform_int_distribution<size_t>(0, words.size() - 1)(generator)] + " "s;
+        }
+        return text;
+    };
+
+    // в expected документы удаляются по одному, в остальных - пакетами
+    SearchServer expected("and"s);
+    SearchServer search_server("and"s);
+    SearchServer par_search_server("and"s);
+    search_server.SetSegmentDocumentCount(16);
+    par_search_server.SetSegmentDocumentCount(16);
+    vector<int> document_ids;
+    for (int document_id = 0; document_id < 300; ++document_id) {
+        const string text = generate_text();
+        const auto status = static_cast<DocumentStatus>(document_id % 4 == 0);
+        for (SearchServer* server : {&expected, &search_server, &par_search_server}) {
+            server->AddDocument(document_id, text, status, {document_id % 10});
+        }
+        document_ids.push_back(document_id);
+    }
+
+    for (int round = 0; round < 4; ++round) {
+        shuffle(document_ids.begin(), document_ids.end(), generator);
+        vector<int> removed(document_ids.end() - 40, document_ids.end());
+        document_ids.resize(document_ids.size() - 40);
+        for (const int document_id : removed) {
+            expected.RemoveDocument(document_id);
+        }
+        removed.push_back(removed.front());
+        search_server.RemoveDocuments(removed);
+        par_search_server.RemoveDocuments(execution::par, removed);
+
+        for (const SearchServer* server : {&search_server, &par_search_server}) {
+            ASSERT_EQUAL(server->GetDocumentCount(), expected.GetDocumentCount());
+            ASSERT_EQUAL(server->GetMemoryUsage().posting_count, expected.GetMemoryUsage().posting_count);
+            for (const string& query : {"fluffy groomed cat"s, "cat -collar"s, "evgeny eyes -white -dog"s}) {
+                for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                    const auto expected_documents = expected.FindTopDocuments(query, status);
+                    const auto documents = server->FindTopDocuments(query, status);
+                    ASSERT_EQUAL(documents.size(), expected_documents.size());
+                    for (size_t i = 0; i < documents.size(); ++i) {
+                        ASSERT_EQUAL(documents[i].id, expected_documents[i].id);
+                        ASSERT_EQUAL(documents[i].relevance, expected_documents[i].relevance);
+                    }
+                }
+            }
+        }
 
-        LOG_DURATION("Single lock");
-        RunConcurrentUpdates(single_lock, 4, 50000);
+        // при неизвестном id не удаляется ни один документ
+        const int document_count = search_server.GetDocumentCount();
+        try {
+            search_server.RemoveDocuments({document_ids.front(), 1000});
+            ASSERT(false);
+        } catch (const out_of_range&) {
+        }
+        ASSERT_EQUAL(search_server.GetDocumentCount(), document_count);
+        ASSERT(search_server.GetWordFrequencies(document_ids.front()).size() > 0);
+    }
+
+    search_server.RemoveDocuments({});
+    search_server.RemoveDocuments(document_ids);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 0);
+    ASSERT(search_server.FindTopDocuments("cat dog parrot"s).empty());
+    search_server.Compact();
+    ASSERT_EQUAL(search_server.GetMemoryUsage().posting_count, 0u);
+}
+
+void TestQueryStatistics() {
+    using namespace chrono;
+    QueryStatistics statistics(seconds(16));
+    const auto start = QueryStatistics::Clock::time_point(hours(1));
+    ASSERT_EQUAL(statistics.GetStats(start).request_count, 0u);
+
+    // 100 запросов в секунду в течение 10 секунд, задержка i микросекунд
+    for (int i = 0; i < 1000; ++i) {
+        statistics.AddRequest(i % 7, microseconds(i + 1), start + milliseconds(i * 10));
+    }
+    QueryStats stats = statistics.GetStats(start + seconds(10));
+    ASSERT_EQUAL(stats.request_count, 1000u);
+    ASSERT_EQUAL(stats.GetNoResultCount(), 143u);
+    ASSERT_EQUAL(stats.result_counts[6], 142u);
+    ASSERT_EQUAL(stats.result_counts[7], 0u);
+    // текущая корзина только началась, окно - 15 целых корзин
+    ASSERT(stats.period == seconds(15));
+    ASSERT(abs(stats.GetQueriesPerSecond() - 1000.0 / 15) < 1e-9);
+    for (const double percentile : {50.0, 90.0, 99.0, 100.0}) {
+        const double expected = percentile * 10;
+        const double actual = duration<double, micro>(stats.GetLatencyPercentile(percentile)).count();
+        ASSERT(actual >= expected && actual <= expected * 1.25);
+    }
+
+    // через окно учтены только запросы последних 15-16 секунд
+    stats = statistics.GetStats(start + seconds(24));
+    ASSERT(stats.request_count > 0 && stats.request_count < 300);
+    ASSERT_EQUAL(statistics.GetStats(start + seconds(30)).request_count, 0u);
+    statistics.AddRequest(20, microseconds(5), start + seconds(40));
+    stats = statistics.GetStats(start + seconds(40));
+    ASSERT_EQUAL(stats.request_count, 1u);
+    ASSERT_EQUAL(stats.result_counts[RESULT_COUNT_BIN_COUNT - 1], 1u);
+
+    // потоки пишут одновременно; корзины не меняются, поэтому ни один запрос не теряется
+    QueryStatistics shared_statistics(hours(1));
+    const auto now = QueryStatistics::Clock::now();
+    vector<future<void>> futures;
+    for (int thread = 0; thread < 8; ++thread) {
+        futures.push_back(async(launch::async, [&shared_statistics, now]() {
+            for (int i = 0; i < 10'000; ++i) {
+                shared_statistics.AddRequest(i % 2, microseconds(100), now);
+            }
+        }));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+    stats = shared_statistics.GetStats(now);
+    ASSERT_EQUAL(stats.request_count, 80'000u);
+    ASSERT_EQUAL(stats.GetNoResultCount(), 40'000u);
+
+    SearchServer search_server("and in at"s);
+    search_server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "big dog sparrow Eugene"s, DocumentStatus::BANNED, {1, 3, 2});
+    RequestQueue request_queue(search_server);
+    for (int i = 0; i < 10; ++i) {
+        request_queue.AddFindRequest("empty request"s);
+    }
+    ASSERT_EQUAL(request_queue.AddFindRequest("curly dog"s).size(), 1u);
+    ASSERT_EQUAL(request_queue.AddFindRequest("big dog"s, DocumentStatus::BANNED).size(), 1u);
+    ASSERT_EQUAL(request_queue.AddFindRequest("sparrow"s, [](int, DocumentStatus, int rating) {
+        return rating > 5;
+    }).size(), 0u);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 11);
+    ASSERT_EQUAL(request_queue.GetStats().request_count, 13u);
+}
+
+void TestDurationHistogram() {
+    using namespace chrono;
+    using Bins = DurationHistogram::Bins;
+    // корзины идут подряд и не шире 1/16 своих значений
+    for (uint64_t value = 0; value < 100'000; ++value) {
+        const size_t bin = Bins::GetBin(value);
+        ASSERT(value <= Bins::GetUpperBound(bin));
+        ASSERT(bin == 0 || Bins::GetUpperBound(bin - 1) < value);
+        ASSERT(Bins::GetUpperBound(bin) - value <= value / 16);
+    }
+    ASSERT_EQUAL(Bins::GetBin((uint64_t{1} << 40) - 1), DurationHistogram::BIN_COUNT - 1);
+
+    DurationHistogram histogram("test"s);
+    vector<future<void>> futures;
+    for (int thread = 0; thread < 4; ++thread) {
+        futures.push_back(async(launch::async, [&histogram]() {
+            for (int i = 1; i <= 10'000; ++i) {
+                histogram.Add(nanoseconds(i));
+            }
+        }));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+    const DurationStats stats = histogram.GetStats();
+    ASSERT_EQUAL(stats.count, 40'000u);
+    ASSERT_EQUAL(stats.total.count(), 4 * 10'000 * 10'001 / 2);
+    for (const auto& [actual, expected] : {pair{stats.p50, 5'000}, pair{stats.p99, 9'900}, pair{stats.p999, 9'990}}) {
+        ASSERT(actual.count() >= expected && actual.count() <= expected + expected / 16);
     }
+
+#ifdef SEARCH_SERVER_PROFILE
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "white cat and fluffy tail"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "black dog"s, DocumentStatus::ACTUAL, {2});
+    search_server.FindTopDocuments("fluffy cat -dog"s, [](int, DocumentStatus, int) { return true; });
+    search_server.RemoveDocument(2);
+    map<string, uint64_t> counts;
+    for (const DurationStats& duration_stats : DurationRegistry::Instance().GetStats()) {
+        counts[duration_stats.name] = duration_stats.count;
+    }
+    for (const string& name : {"index.add_document"s, "index.remove_document"s, "search.parse"s,
+                               "search.minus_words"s, "search.postings"s, "search.sort"s}) {
+        ASSERT(counts[name] > 0);
+    }
+#endif
+}
+
+void TestMatchDocument() {
+    const vector<string> words = {"cat"s, "dog"s, "white"s, "fluffy"s, "tail"s, "collar"s, "eyes"s,
+                                  "groomed"s, "starling"s, "evgeny"s, "parrot"s, "and"s};
+    mt19937 generator(25);
+    auto generate_text = [&](int max_word_count, double minus_prob) {
+        string text;
+        for (int i = uniform_int_distribution(1, max_word_count)(generator); i > 0; --i) {
+            if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+                text += "-"s;
+            }
+            text += words[uniform_int_distribution<size_t>(0, words.size() - 1)(generator)] + " "s;
+        }
+        return text;
+    };
+
+    SearchServer search_server("and"s);
+    search_server.SetSegmentDocumentCount(16);
+    for (int document_id = 0; document_id < 100; ++document_id) {
+        search_server.AddDocument(document_id, generate_text(8, 0.0), static_cast<DocumentStatus>(document_id % 4), {1});
+    }
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    for (int i = 0; i < 50; ++i) {
+        const string query = generate_text(5, 0.3);
+        const auto batch = search_server.MatchDocuments(query, document_ids);
+        ASSERT_EQUAL(batch.size(), document_ids.size());
+        for (size_t j = 0; j < document_ids.size(); ++j) {
+            const int document_id = document_ids[j];
+            const auto document_words = search_server.GetWordFrequencies(document_id);
+            // наивное сопоставление по словам документа
+            set<string_view> plus_words;
+            bool has_minus_word = false;
+            for (string_view word : SplitIntoWords(query)) {
+                const bool is_minus = word[0] == '-';
+                if (is_minus) {
+                    word.remove_prefix(1);
+                }
+                if (document_words.count(word) > 0) {
+                    if (is_minus) {
+                        has_minus_word = true;
+                    } else {
+                        plus_words.insert(word);
+                    }
+                }
+            }
+            const vector<string_view> expected_words = has_minus_word ? vector<string_view>{}
+                                                                      : vector<string_view>(plus_words.begin(), plus_words.end());
+            const auto expected = tuple{expected_words, static_cast<DocumentStatus>(document_id % 4)};
+            ASSERT(search_server.MatchDocument(query, document_id) == expected);
+            ASSERT(search_server.MatchDocument(execution::seq, query, document_id) == expected);
+            ASSERT(search_server.MatchDocument(execution::par, query, document_id) == expected);
+            ASSERT(batch[j] == expected);
+        }
+    }
+
+    try {
+        search_server.MatchDocuments("cat"s, {0, 1000});
+        ASSERT(false);
+    } catch (const out_of_range&) {
+    }
+    try {
+        search_server.MatchDocuments("cat --dog"s, {0});
+        ASSERT(false);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT(search_server.MatchDocuments("cat"s, {}).empty());
+}
+
+void TestDynamicPruning() {
+    // частоты слов убывают по закону Ципфа, как в живых текстах
+    mt19937 generator(17);
+    vector<string> words;
+    vector<double> weights;
+    for (int i = 0; i < 300; ++i) {
+        words.push_back("w"s + to_string(i));
+        weights.push_back(1.0 / (i + 1));
+    }
+    discrete_distribution<size_t> word_distribution(weights.begin(), weights.end());
+    auto generate_text = [&](int word_count) {
+        string text;
+        for (int i = 0; i < word_count; ++i) {
+            text += words[word_distribution(generator)] + " "s;
+        }
+        return text;
+    };
+
+    SearchServer search_server(""s);
+    search_server.SetSegmentDocumentCount(256);
+    for (int id = 0; id < 3000; ++id) {
+        search_server.AddDocument(id, generate_text(uniform_int_distribution(1, 30)(generator)),
+                                  static_cast<DocumentStatus>(id % 4 == 0), {id % 11});
+    }
+    for (int id = 0; id < 3000; id += 7) {
+        search_server.RemoveDocument(id);
+    }
+
+    vector<string> queries;
+    for (int i = 0; i < 100; ++i) {
+        queries.push_back(generate_text(uniform_int_distribution(1, 12)(generator)));
+        if (i % 3 == 0) {
+            queries.back() += "-"s + words[word_distribution(generator)];
+        }
+    }
+    const auto even_rating = [](int, DocumentStatus, int rating) { return rating % 2 == 0; };
+    for (const size_t max_result_document_count : {1, 5, 50}) {
+        search_server.SetMaxResultDocumentCount(max_result_document_count);
+        for (const string& query : queries) {
+            search_server.SetDynamicPruning(false);
+            const auto expected = search_server.FindTopDocuments(query);
+            const auto expected_even = search_server.FindTopDocuments(query, even_rating);
+            search_server.SetDynamicPruning(true);
+            for (const auto& [actual, expected_documents] :
+                 {pair{search_server.FindTopDocuments(query), expected},
+                  pair{search_server.FindTopDocuments(execution::par, query), expected},
+                  pair{search_server.FindTopDocuments(query, even_rating), expected_even}}) {
+                ASSERT_EQUAL(actual.size(), expected_documents.size());
+                for (size_t i = 0; i < actual.size(); ++i) {
+                    ASSERT_EQUAL(actual[i].id, expected_documents[i].id);
+                    ASSERT_EQUAL(actual[i].relevance, expected_documents[i].relevance);
+                    ASSERT_EQUAL(actual[i].rating, expected_documents[i].rating);
+                }
+            }
+        }
+    }
+}
+
+void TestDocumentFilter() {
+    mt19937 generator(23);
+    vector<string> words;
+    vector<double> weights;
+    for (int i = 0; i < 300; ++i) {
+        words.push_back("w"s + to_string(i));
+        weights.push_back(1.0 / (i + 1));
+    }
+    discrete_distribution<size_t> word_distribution(weights.begin(), weights.end());
+    auto generate_text = [&](int word_count) {
+        string text;
+        for (int i = 0; i < word_count; ++i) {
+            text += words[word_distribution(generator)] + " "s;
+        }
+        return text;
+    };
+
+    // заблокированных документов мало, и их ищут по самим документам, а не по спискам вхождений
+    SearchServer search_server(""s);
+    search_server.SetSegmentDocumentCount(256);
+    for (int id = 0; id < 3000; ++id) {
+        const DocumentStatus status = id % 50 == 0 ? DocumentStatus::BANNED : static_cast<DocumentStatus>(id % 3 == 0);
+        search_server.AddDocument(id, generate_text(uniform_int_distribution(1, 30)(generator)), status, {id % 11});
+    }
+    for (int id = 0; id < 3000; id += 7) {
+        search_server.RemoveDocument(id);
+    }
+
+    vector<string> queries;
+    for (int i = 0; i < 50; ++i) {
+        queries.push_back(generate_text(uniform_int_distribution(1, 8)(generator)));
+        if (i % 3 == 0) {
+            queries.back() += "-"s + words[word_distribution(generator)];
+        }
+    }
+    vector<int> few_ids = {3, 3, 8, 14, 100, 101, 2999, 5000};
+    vector<int> many_ids;
+    for (int id = 0; id < 3000; id += 2) {
+        many_ids.push_back(id);
+    }
+    const vector<pair<DocumentFilter, function<bool(int, DocumentStatus, int)>>> filters = {
+        {DocumentFilter{}, [](int, DocumentStatus status, int) { return status == DocumentStatus::ACTUAL; }},
+        {DocumentFilter{{DocumentStatus::BANNED}, numeric_limits<int>::min(), numeric_limits<int>::max(), nullopt},
+         [](int, DocumentStatus status, int) { return status == DocumentStatus::BANNED; }},
+        {DocumentFilter{{DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT}, 3, 7, nullopt},
+         [](int, DocumentStatus status, int rating) {
+             return status != DocumentStatus::BANNED && rating >= 3 && rating <= 7;
+         }},
+        {DocumentFilter{{DocumentStatus::ACTUAL}, numeric_limits<int>::min(), numeric_limits<int>::max(), few_ids},
+         [&few_ids](int document_id, DocumentStatus status, int) {
+             return status == DocumentStatus::ACTUAL && count(few_ids.begin(), few_ids.end(), document_id) > 0;
+         }},
+        {DocumentFilter{{DocumentStatus::ACTUAL, DocumentStatus::BANNED}, 2, 9, many_ids},
+         [](int document_id, DocumentStatus status, int rating) {
+             return status != DocumentStatus::IRRELEVANT && rating >= 2 && rating <= 9 && document_id % 2 == 0;
+         }},
+    };
+    auto check = [&] {
+        QueryContext context;
+        for (const string& query : queries) {
+            for (const auto& [filter, predicate] : filters) {
+                const auto expected = search_server.FindTopDocuments(query, predicate);
+                for (const auto& actual : {search_server.FindTopDocuments(query, filter),
+                                           search_server.FindTopDocuments(execution::par, query, filter),
+                                           search_server.FindTopDocuments(context, query, filter)}) {
+                    ASSERT_EQUAL(actual.size(), expected.size());
+                    for (size_t i = 0; i < actual.size(); ++i) {
+                        ASSERT_EQUAL(actual[i].id, expected[i].id);
+                        ASSERT_EQUAL(actual[i].relevance, expected[i].relevance);
+                        ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+                    }
+                }
+            }
+            const auto expected_banned = search_server.FindTopDocuments(query, filters[1].second);
+            ASSERT_EQUAL(search_server.FindTopDocuments(query, DocumentStatus::BANNED).size(), expected_banned.size());
+        }
+    };
+    check();
+    search_server.Compact();
+    for (int id = 1; id < 3000; id += 13) {
+        if (id % 7 != 0) {
+            search_server.RemoveDocument(id);
+        }
+    }
+    search_server.AddDocument(5000, "w0 w1 w2"s, DocumentStatus::BANNED, {5});
+    check();
+}
+
+void TestProcessQueryBatch() {
+    SearchServer search_server("and with"s);
+    int id = 0;
+    for (const string& text : {"funny pet and nasty rat"s, "funny pet with curly hair"s, "nasty rat with curly tail"s,
+                               "pet with big eyes"s, "big rat and funny cat"s, "curly cat curly tail"s}) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {id});
+    }
+    // одинаковые после разбора запросы: порядок и повторы слов, стоп-слова
+    const vector<string> queries = {"curly rat"s, "rat curly"s, "funny -nasty"s, "curly rat"s, "rat and curly curly"s,
+                                    "unknown"s, "pet -rat"s, ""s, "funny -nasty"s};
+    const QueryBatchResult batch = ProcessQueryBatch(search_server, queries);
+    ASSERT_EQUAL(batch.size(), queries.size());
+    vector<Document> joined;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = search_server.FindTopDocuments(queries[i]);
+        ASSERT_EQUAL(batch[i].size(), expected.size());
+        size_t j = 0;
+        for (const Document& document : batch[i]) {
+            ASSERT_EQUAL(document.id, expected[j].id);
+            ASSERT_EQUAL(document.relevance, expected[j].relevance);
+            ++j;
+        }
+        joined.insert(joined.end(), expected.begin(), expected.end());
+    }
+    const auto actual_joined = ProcessQueriesJoined(search_server, queries);
+    ASSERT_EQUAL(actual_joined.size(), joined.size());
+    for (size_t i = 0; i < joined.size(); ++i) {
+        ASSERT_EQUAL(actual_joined[i].id, joined[i].id);
+    }
+    ASSERT_EQUAL(ProcessQueries(search_server, queries).size(), queries.size());
+    ASSERT(ProcessQueryBatch(search_server, {}).GetDocuments().empty());
+
+    try {
+        ProcessQueryBatch(search_server, {"cat"s, "cat --dog"s});
+        ASSERT(false);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestRemoveDuplicates() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    // отличие только в стоп-словах
+    search_server.AddDocument(3, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    // отличие только в повторах и порядке слов
+    search_server.AddDocument(4, "funny pet and curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(5, "funny funny pet and nasty nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(6, "funny pet and not very nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(7, "very nasty rat and not very funny pet"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(8, "pet with rat and rat and rat"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(9, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    ASSERT(FindDuplicates(search_server) == vector<int>({3, 4, 5, 7}));
+    // {funny pet nasty rat} и {funny pet not very nasty rat}: 4 общих слова из 6
+    ASSERT(FindDuplicates(search_server, 0.6) == vector<int>({3, 4, 5, 6, 7}));
+    RemoveDuplicates(search_server);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 5);
+    ASSERT(FindDuplicates(search_server).empty());
+
+    // почти дубликаты среди множества непохожих документов
+    mt19937 generator(5);
+    SearchServer large_server(""s);
+    vector<int> expected;
+    for (int document_id = 0; document_id < 2000; ++document_id) {
+        vector<string> words;
+        for (int i = 0; i < 40; ++i) {
+            words.push_back("w"s + to_string(uniform_int_distribution(0, 100'000)(generator)));
+        }
+        string text;
+        for (const string& word : words) {
+            text += word + " "s;
+        }
+        large_server.AddDocument(document_id * 2, text, DocumentStatus::ACTUAL, {1});
+        if (document_id % 10 == 0) {
+            // два слова из сорока заменены: похожесть 38 / 42
+            text += "extra1 extra2"s;
+            text.replace(0, words[0].size() + words[1].size() + 2, "");
+            large_server.AddDocument(document_id * 2 + 1, text, DocumentStatus::ACTUAL, {1});
+            expected.push_back(document_id * 2 + 1);
+        }
+    }
+    ASSERT(FindDuplicates(large_server).empty());
+    ASSERT(FindDuplicates(large_server, 0.8) == expected);
+}
+
+void TestMemoryUsageUnderChurn() {
+    constexpr int DOCUMENT_COUNT = 200;
+
+    SearchServer search_server("and with"s);
+    auto add_generation = [&search_server](int generation) {
+        for (int i = 0; i < DOCUMENT_COUNT; ++i) {
+            const string unique_word = "w"s + to_string(generation) + "x"s + to_string(i) + string(20, 'z');
+            search_server.AddDocument(generation * DOCUMENT_COUNT + i, "cat and dog with "s + unique_word,
+                                      DocumentStatus::ACTUAL, {1});
+        }
+    };
+
+    add_generation(0);
+    search_server.Compact();
+    const MemoryUsage initial = search_server.GetMemoryUsage();
+    ASSERT_EQUAL(initial.term_count, static_cast<size_t>(DOCUMENT_COUNT + 2));
+    ASSERT_EQUAL(initial.posting_count, static_cast<size_t>(3 * DOCUMENT_COUNT));
+
+    for (int generation = 1; generation <= 10; ++generation) {
+        for (int i = 0; i < DOCUMENT_COUNT; ++i) {
+            const int document_id = (generation - 1) * DOCUMENT_COUNT + i;
+            if (i % 2 == 0) {
+                search_server.RemoveDocument(document_id);
+            } else {
+                search_server.RemoveDocument(execution::par, document_id);
+            }
+        }
+        add_generation(generation);
+        search_server.Compact();
+
+        const MemoryUsage usage = search_server.GetMemoryUsage();
+        ASSERT_EQUAL(usage.term_count, initial.term_count);
+        ASSERT_EQUAL(usage.posting_count, initial.posting_count);
+        ASSERT(usage.Total() <= initial.Total() * 11 / 10);
+    }
+    ASSERT_EQUAL(search_server.FindTopDocuments("w10x7"s + string(20, 'z')).size(), 1u);
+}
+
+string GenerateWord(mt19937& generator, int max_length) {
+    const int length = uniform_int_distribution(1, max_length)(generator);
+    string word;
+    word.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        word.push_back(uniform_int_distribution('a', 'z')(generator));
+    }
+    return word;
+}
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        words.push_back(GenerateWord(generator, max_length));
+    }
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
+    string query;
+    for (int i = 0; i < word_count; ++i) {
+        if (!query.empty()) {
+            query.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            query.push_back('-');
+        }
+        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    }
+    return query;
+}
+
+vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+    }
+    return queries;
+}
+
+// Запросы раздаются thread_count клиентским потокам, как при обслуживании нагрузки.
+// Возвращает сумму релевантностей выдачи для сверки вариантов между собой.
+template <typename ExecutionPolicy>
+double BenchmarkFindTopDocuments(string_view mark, const SearchServer& search_server, const vector<string>& queries,
+                               ExecutionPolicy&& policy, size_t thread_count = 1) {
+    LOG_DURATION(string{mark} + ", threads: "s + to_string(thread_count));
+    vector<future<double>> futures;
+    for (size_t thread = 0; thread < thread_count; ++thread) {
+        futures.push_back(async(launch::async, [&, thread] {
+            double total_relevance = 0;
+            for (size_t i = thread; i < queries.size(); i += thread_count) {
+                for (const auto& document : search_server.FindTopDocuments(policy, queries[i])) {
+                    total_relevance += document.relevance;
+                }
+            }
+            return total_relevance;
+        }));
+    }
+    double total_relevance = 0;
+    for (auto& f : futures) {
+        total_relevance += f.get();
+    }
+    ASSERT(total_relevance > 0);
+    return total_relevance;
+}
+
+void TestSplitIntoWordsSpeed() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 12);
+    const auto texts = GenerateQueries(generator, dictionary, 10'000, 100);
+
+    auto benchmark = [&texts](string_view mark, auto split) {
+        LOG_DURATION(string{mark});
+        vector<string_view> words;
+        size_t word_count = 0;
+        for (int repeat = 0; repeat < 10; ++repeat) {
+            for (const string& text : texts) {
+                ASSERT(split(text, words));
+                word_count += words.size();
+            }
+        }
+        return word_count;
+    };
+    const size_t word_count = benchmark("SplitIntoWords find + IsValidWord"sv, SplitIntoWordsByFind);
+    ASSERT_EQUAL(benchmark("SplitIntoWords scalar"sv, SplitIntoWordsScalar), word_count);
+    ASSERT_EQUAL(benchmark("SplitIntoWords"sv, [](string_view text, vector<string_view>& words) {
+        return SplitIntoWords(text, words);
+    }), word_count);
+}
+
+void TestProcessQueryBatchSpeed() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 25);
+    const auto documents = GenerateQueries(generator, dictionary, 100'000, 70);
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    // пакет из популярных запросов: каждый повторяется в среднем десять раз
+    const auto popular_queries = GenerateQueries(generator, dictionary, 2'000, 7);
+    vector<string> queries;
+    for (int i = 0; i < 20'000; ++i) {
+        queries.push_back(popular_queries[uniform_int_distribution<size_t>(0, popular_queries.size() - 1)(generator)]);
+    }
+
+    size_t document_count = 0;
+    {
+        LOG_DURATION("Queries one by one"s);
+        for (const string& query : queries) {
+            document_count += search_server.FindTopDocuments(query).size();
+        }
+    }
+    size_t joined_document_count = 0;
+    {
+        LOG_DURATION("ProcessQueriesJoined"s);
+        joined_document_count = ProcessQueriesJoined(search_server, queries).size();
+    }
+    ASSERT_EQUAL(joined_document_count, document_count);
+}
+
+void TestRemoveDuplicatesSpeed() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 25);
+    const auto documents = GenerateQueries(generator, dictionary, 200'000, 30);
+    SearchServer search_server(""s);
+    // повтор берёт исходный текст документа, и если тот сам был повтором, такого текста в индексе нет
+    set<set<string_view>> word_sets;
+    size_t expected_duplicate_count = 0;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        // каждый пятый документ повторяет текст одного из предыдущих
+        const string& text = i % 5 == 4 ? documents[uniform_int_distribution<size_t>(0, i - 1)(generator)] : documents[i];
+        search_server.AddDocument(i, text, DocumentStatus::ACTUAL, {1});
+        const vector<string_view> words = SplitIntoWords(string_view{text});
+        if (!word_sets.emplace(words.begin(), words.end()).second) {
+            ++expected_duplicate_count;
+        }
+    }
+    size_t duplicate_count = 0;
+    {
+        LOG_DURATION("FindDuplicates exact"s);
+        duplicate_count = FindDuplicates(search_server).size();
+    }
+    ASSERT_EQUAL(duplicate_count, expected_duplicate_count);
+    {
+        LOG_DURATION("FindDuplicates similarity 0.8"s);
+        duplicate_count = FindDuplicates(search_server, 0.8).size();
+    }
+    ASSERT(duplicate_count >= expected_duplicate_count);
+}
+
+void TestRemoveDocumentsSpeed() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 25);
+    const auto documents = GenerateQueries(generator, dictionary, 200'000, 30);
+    // удаляется каждый второй документ
+    vector<int> removed;
+    for (size_t i = 0; i < documents.size(); i += 2) {
+        removed.push_back(i);
+    }
+    shuffle(removed.begin(), removed.end(), generator);
+    for (const bool batch : {false, true}) {
+        SearchServer search_server(""s);
+        // половина документов в неизменяемом сегменте, половина - в изменяемом
+        search_server.SetSegmentDocumentCount(documents.size() / 2);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1});
+        }
+        LOG_DURATION(batch ? "RemoveDocuments"s : "RemoveDocument"s);
+        if (batch) {
+            search_server.RemoveDocuments(removed);
+        } else {
+            for (const int document_id : removed) {
+                search_server.RemoveDocument(document_id);
+            }
+        }
+    }
+}
+
+void TestQueryStatisticsSpeed() {
+    QueryStatistics statistics;
+    const int thread_count = 8;
+    const int request_count = 1'000'000;
+    LOG_DURATION("QueryStatistics "s + to_string(thread_count) + " threads"s);
+    vector<future<void>> futures;
+    for (int thread = 0; thread < thread_count; ++thread) {
+        futures.push_back(async(launch::async, [&statistics]() {
+            for (int i = 0; i < request_count; ++i) {
+                statistics.AddRequest(i % 6, chrono::nanoseconds(i % 100'000));
+            }
+        }));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+    // запросы, попавшие в корзину во время её обнуления, теряются
+    const uint64_t counted = statistics.GetStats().request_count;
+    ASSERT(counted > 0 && counted <= uint64_t{thread_count} * request_count);
+}
+
+void TestMatchDocumentSpeed() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 25);
+    const auto documents = GenerateQueries(generator, dictionary, 100'000, 100);
+    SearchServer search_server(""s);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1});
+    }
+    const auto queries = GenerateQueries(generator, dictionary, 10'000, 7);
+    // страницы выдачи по 10 документов
+    vector<vector<int>> pages(queries.size());
+    for (auto& page : pages) {
+        for (int i = 0; i < 10; ++i) {
+            page.push_back(uniform_int_distribution<int>(0, documents.size() - 1)(generator));
+        }
+    }
+    size_t word_count = 0;
+    {
+        LOG_DURATION("MatchDocument per page document"s);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            for (const int document_id : pages[i]) {
+                word_count += get<0>(search_server.MatchDocument(queries[i], document_id)).size();
+            }
+        }
+    }
+    size_t par_word_count = 0;
+    {
+        LOG_DURATION("MatchDocument par per page document"s);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            for (const int document_id : pages[i]) {
+                par_word_count += get<0>(search_server.MatchDocument(execution::par, queries[i], document_id)).size();
+            }
+        }
+    }
+    size_t batch_word_count = 0;
+    {
+        LOG_DURATION("MatchDocuments per page"s);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            for (const auto& match : search_server.MatchDocuments(queries[i], pages[i])) {
+                batch_word_count += get<0>(match).size();
+            }
+        }
+    }
+    ASSERT(word_count > 0);
+    ASSERT_EQUAL(par_word_count, word_count);
+    ASSERT_EQUAL(batch_word_count, word_count);
+}
+
+void TestDynamicPruningSpeed() {
+    constexpr int DOCUMENT_COUNT = 300'000;
+
+    // слова с частотами по закону Ципфа, поэтому в запросах преобладают частые слова
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 50'000, 10);
+    vector<double> weights;
+    for (size_t i = 0; i < dictionary.size(); ++i) {
+        weights.push_back(1.0 / (i + 1));
+    }
+    discrete_distribution<size_t> word_distribution(weights.begin(), weights.end());
+    auto generate_text = [&](int word_count) {
+        string text;
+        for (int i = 0; i < word_count; ++i) {
+            text += dictionary[word_distribution(generator)] + " "s;
+        }
+        return text;
+    };
+
+    SearchServer search_server(""s);
+    for (int id = 0; id < DOCUMENT_COUNT; ++id) {
+        search_server.AddDocument(id, generate_text(uniform_int_distribution(5, 50)(generator)),
+                                  DocumentStatus::ACTUAL, {id % 10});
+    }
+    vector<string> queries;
+    for (int i = 0; i < 300; ++i) {
+        queries.push_back(generate_text(10));
+    }
+
+    search_server.SetDynamicPruning(false);
+    BenchmarkFindTopDocuments("FindTopDocuments long common-word queries, exhaustive", search_server, queries,
+                              execution::seq);
+    search_server.SetDynamicPruning(true);
+    BenchmarkFindTopDocuments("FindTopDocuments long common-word queries, pruning", search_server, queries,
+                              execution::seq);
+
+    // частое минус-слово исключает большую часть документов с плюс-словами
+    for (string& query : queries) {
+        query += " -"s + dictionary[uniform_int_distribution(0, 2)(generator)];
+    }
+    search_server.SetDynamicPruning(false);
+    BenchmarkFindTopDocuments("FindTopDocuments common minus words, exhaustive", search_server, queries,
+                              execution::seq);
+    search_server.SetDynamicPruning(true);
+    BenchmarkFindTopDocuments("FindTopDocuments common minus words, pruning", search_server, queries,
+                              execution::seq);
+}
+
+void TestDocumentFilterSpeed() {
+    constexpr int DOCUMENT_COUNT = 300'000;
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 50'000, 10);
+    vector<double> weights;
+    for (size_t i = 0; i < dictionary.size(); ++i) {
+        weights.push_back(1.0 / (i + 1));
+    }
+    discrete_distribution<size_t> word_distribution(weights.begin(), weights.end());
+    auto generate_text = [&](int word_count) {
+        string text;
+        for (int i = 0; i < word_count; ++i) {
+            text += dictionary[word_distribution(generator)] + " "s;
+        }
+        return text;
+    };
+
+    SearchServer search_server(""s);
+    for (int id = 0; id < DOCUMENT_COUNT; ++id) {
+        const DocumentStatus status = id % 100 == 0 ? DocumentStatus::BANNED
+            : id % 5 == 0                           ? DocumentStatus::IRRELEVANT
+                                                    : DocumentStatus::ACTUAL;
+        search_server.AddDocument(id, generate_text(uniform_int_distribution(5, 50)(generator)), status, {id % 100});
+    }
+    vector<string> queries;
+    for (int i = 0; i < 300; ++i) {
+        queries.push_back(generate_text(5));
+    }
+    vector<int> document_ids;
+    for (int i = 0; i < 1000; ++i) {
+        document_ids.push_back(uniform_int_distribution(0, DOCUMENT_COUNT - 1)(generator));
+    }
+    const unordered_set<int> document_id_set(document_ids.begin(), document_ids.end());
+
+    // предикат и фильтр с тем же условием должны давать одну выдачу
+    auto benchmark = [&](const string& mark, const auto& filter) {
+        LOG_DURATION(mark);
+        double total_relevance = 0;
+        for (const string& query : queries) {
+            for (const auto& document : search_server.FindTopDocuments(query, filter)) {
+                total_relevance += document.relevance;
+            }
+        }
+        return total_relevance;
+    };
+    const double banned_relevance = benchmark("Banned documents, predicate"s, [](int, DocumentStatus status, int) {
+        return status == DocumentStatus::BANNED;
+    });
+    ASSERT_EQUAL(benchmark("Banned documents, filter"s,
+                           DocumentFilter{{DocumentStatus::BANNED}, numeric_limits<int>::min(),
+                                          numeric_limits<int>::max(), nullopt}),
+                 banned_relevance);
+    const double rating_relevance = benchmark("Rating range, predicate"s, [](int, DocumentStatus status, int rating) {
+        return status == DocumentStatus::ACTUAL && rating >= 40 && rating < 50;
+    });
+    ASSERT_EQUAL(benchmark("Rating range, filter"s, DocumentFilter{{DocumentStatus::ACTUAL}, 40, 49, nullopt}),
+                 rating_relevance);
+    const double allowed_relevance = benchmark("1000 allowed ids, predicate"s,
+                                               [&document_id_set](int document_id, DocumentStatus, int) {
+        return document_id_set.count(document_id) > 0;
+    });
+    ASSERT_EQUAL(benchmark("1000 allowed ids, filter"s,
+                           DocumentFilter{{DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED},
+                                          numeric_limits<int>::min(), numeric_limits<int>::max(), document_ids}),
+                 allowed_relevance);
+}
+
+void TestSearchServerSpeed() {
+    constexpr int DOCUMENT_COUNT = 1'000'000;
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, DOCUMENT_COUNT, 10);
+    const auto queries = GenerateQueries(generator, dictionary, 1'000, 7);
+
     {
-        ConcurrentMap<int, int> many_locks(100);
+        vector<NewDocument> batch;
+        batch.reserve(documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+        }
+        for (const bool parallel : {false, true}) {
+            SearchServer search_server(dictionary[0]);
+            LOG_DURATION(parallel ? "AddDocuments par"s : "AddDocuments seq"s);
+            if (parallel) {
+                search_server.AddDocuments(execution::par, batch);
+            } else {
+                search_server.AddDocuments(execution::seq, batch);
+            }
+        }
+    }
 
-        LOG_DURATION("100 locks");
-        RunConcurrentUpdates(many_locks, 4, 50000);
+    SearchServer search_server(dictionary[0]);
+    {
+        LOG_DURATION("AddDocument");
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+    }
+    {
+        // каждое различное слово документа, кроме стоп-слова, даёт одно вхождение
+        size_t posting_count = 0;
+        for (const string& document : documents) {
+            const vector<string_view> words = SplitIntoWords(string_view{document});
+            set<string_view> unique_words(words.begin(), words.end());
+            unique_words.erase(dictionary[0]);
+            posting_count += unique_words.size();
+        }
+        const MemoryUsage usage = search_server.GetMemoryUsage();
+        ASSERT_EQUAL(usage.posting_count, posting_count);
+        // почти все вхождения лежат в сжатых неизменяемых сегментах
+        ASSERT(usage.posting_bytes < 4 * usage.posting_count);
+    }
+
+    {
+        const string path = "search_server_speed.snapshot"s;
+        // снимок индекса на миллион документов велик, поэтому удаляется и при провале проверок
+        struct SnapshotRemover {
+            const string& path;
+
+            ~SnapshotRemover() {
+                remove(path.c_str());
+            }
+        } snapshot_remover{path};
+        {
+            LOG_DURATION("SaveSnapshot"s);
+            search_server.SaveSnapshot(path);
+        }
+        optional<SearchServer> loaded;
+        {
+            LOG_DURATION("LoadSnapshot"s);
+            loaded.emplace(SearchServer::LoadSnapshot(path));
+        }
+        ASSERT_EQUAL(loaded->GetDocumentCount(), search_server.GetDocumentCount());
+        BenchmarkFindTopDocuments("FindTopDocuments seq, loaded snapshot", *loaded, queries, execution::seq, 1);
+        {
+            LOG_DURATION("RemoveDocument, every 10th document"s);
+            for (size_t i = 0; i < documents.size(); i += 10) {
+                loaded->RemoveDocument(i);
+            }
+        }
+        BenchmarkFindTopDocuments("FindTopDocuments seq, removed documents", *loaded, queries, execution::seq, 1);
+        {
+            LOG_DURATION("Compact"s);
+            loaded->Compact();
+        }
+        BenchmarkFindTopDocuments("FindTopDocuments seq, compacted", *loaded, queries, execution::seq, 1);
+    }
+
+    {
+        double total_relevance = 0;
+        {
+            LOG_DURATION("FindTopDocuments with QueryContext"s);
+            QueryContext context;
+            for (const string& query : queries) {
+                for (const Document& document : search_server.FindTopDocuments(context, query)) {
+                    total_relevance += document.relevance;
+                }
+            }
+        }
+        double expected_relevance = 0;
+        for (const string& query : queries) {
+            for (const Document& document : search_server.FindTopDocuments(query)) {
+                expected_relevance += document.relevance;
+            }
+        }
+        ASSERT_EQUAL(total_relevance, expected_relevance);
+    }
+
+    {
+        // перекошенный поток запросов: большая часть приходится на 1% самых частых
+        vector<string> skewed_queries;
+        for (int i = 0; i < 10'000; ++i) {
+            const bool is_hot = uniform_int_distribution(0, 9)(generator) < 9;
+            const size_t query_count = is_hot ? queries.size() / 100 : queries.size();
+            skewed_queries.push_back(queries[uniform_int_distribution<size_t>(0, query_count - 1)(generator)]);
+        }
+        BenchmarkFindTopDocuments("FindTopDocuments skewed, no cache", search_server, skewed_queries, execution::seq);
+        search_server.SetQueryCacheCapacity(1'000);
+        BenchmarkFindTopDocuments("FindTopDocuments skewed, cache", search_server, skewed_queries, execution::seq);
+        // кэш вмещает все различные запросы, так что промахивается не больше одного раза на запрос
+        const QueryCacheStats stats = search_server.GetQueryCacheStats();
+        ASSERT(stats.misses <= set<string>(skewed_queries.begin(), skewed_queries.end()).size());
+        ASSERT_EQUAL(stats.hits + stats.misses, skewed_queries.size());
+        search_server.SetQueryCacheCapacity(0);
+    }
+
+    for (size_t thread_count : {1, 2, 4, 8}) {
+        const double seq_relevance = BenchmarkFindTopDocuments("FindTopDocuments seq", search_server, queries,
+                                                               execution::seq, thread_count);
+        const double par_relevance = BenchmarkFindTopDocuments("FindTopDocuments par", search_server, queries,
+                                                               execution::par, thread_count);
+        // документы с равной релевантностью на границе топа могут складываться в другом порядке
+        ASSERT(abs(seq_relevance - par_relevance) <= 1e-9 * seq_relevance);
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     TestRunner tr;
     RUN_TEST(tr, TestConcurrentUpdate);
     RUN_TEST(tr, TestReadAndWrite);
+    RUN_TEST(tr, TestConcurrentErase);
     RUN_TEST(tr, TestSpeedup);
+    RUN_TEST(tr, TestSplitIntoWords);
+    RUN_TEST(tr, TestPostingList);
+    RUN_TEST(tr, TestSegment);
+    RUN_TEST(tr, TestOrdinalSet);
+    RUN_TEST(tr, TestMaxResultDocumentCount);
+    RUN_TEST(tr, TestInverseDocumentFreqRefresh);
+    RUN_TEST(tr, TestQueryContextAllocations);
+    RUN_TEST(tr, TestQueryCache);
+    RUN_TEST(tr, TestAddDocuments);
+    RUN_TEST(tr, TestConcurrentSearchServer);
+    RUN_TEST(tr, TestSnapshot);
+    RUN_TEST(tr, TestSnapshotSavedOverSource);
+    RUN_TEST(tr, TestSegments);
+    RUN_TEST(tr, TestRemoveDocuments);
+    RUN_TEST(tr, TestDynamicPruning);
+    RUN_TEST(tr, TestDocumentFilter);
+    RUN_TEST(tr, TestProcessQueryBatch);
+    RUN_TEST(tr, TestQueryStatistics);
+    RUN_TEST(tr, TestDurationHistogram);
+    RUN_TEST(tr, TestMatchDocument);
+    RUN_TEST(tr, TestRemoveDuplicates);
+    RUN_TEST(tr, TestMemoryUsageUnderChurn);
+    // замеры производительности строят индексы на сотни тысяч документов и идут долго,
+    // поэтому запускаются только с флагом --speed
+    if (argc > 1 && argv[1] == "--speed"sv) {
+        RUN_TEST(tr, TestSplitIntoWordsSpeed);
+        RUN_TEST(tr, TestSearchServerSpeed);
+        RUN_TEST(tr, TestDynamicPruningSpeed);
+        RUN_TEST(tr, TestDocumentFilterSpeed);
+        RUN_TEST(tr, TestProcessQueryBatchSpeed);
+        RUN_TEST(tr, TestRemoveDuplicatesSpeed);
+        RUN_TEST(tr, TestRemoveDocumentsSpeed);
+        RUN_TEST(tr, TestQueryStatisticsSpeed);
+        RUN_TEST(tr, TestMatchDocumentSpeed);
+    }
+#ifdef SEARCH_SERVER_PROFILE
+    DurationRegistry::Instance().Print(cerr);
+#endif
 }
\ No newline at end of file
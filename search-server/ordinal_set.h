@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Множество порядковых номеров документов - битовая карта по бит на номер.
+// Помнит затронутые слова карты, поэтому очистка стоит O(числа вставок),
+// а не O(числа документов). Рассчитано на повторное использование между запросами.
+class OrdinalSet {
+public:
+    // Очищает множество и готовит его для номеров [0, ordinal_count)
+    void Reset(size_t ordinal_count) {
+        for (const uint32_t word : touched_words_) {
+            bits_[word] = 0;
+        }
+        touched_words_.clear();
+        const size_t word_count = (ordinal_count + 63) / 64;
+        if (bits_.size() < word_count) {
+            bits_.resize(word_count, 0);
+        }
+    }
+
+    void Insert(uint32_t ordinal) {
+        uint64_t& word = bits_[ordinal / 64];
+        if (word == 0) {
+            touched_words_.push_back(ordinal / 64);
+        }
+        word |= uint64_t{1} << (ordinal % 64);
+    }
+
+    bool Contains(uint32_t ordinal) const {
+        return (bits_[ordinal / 64] >> (ordinal % 64) & 1) != 0;
+    }
+
+    bool empty() const {
+        return touched_words_.empty();
+    }
+
+private:
+    std::vector<uint64_t> bits_;
+    std::vector<uint32_t> touched_words_;
+};
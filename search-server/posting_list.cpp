@@ -0,0 +1,129 @@
+#include "posting_list.h"
+
+#include <cmath>
+
+namespace {
+
+template <typename Postings>
+auto LowerBound(Postings& postings, int document_id) {
+    return std::lower_bound(postings.begin(), postings.end(), document_id,
+        [](const Posting& posting, int id) { return posting.document_id < id; });
+}
+
+}
+
+void PostingList::Add(const Posting& posting) {
+    const int document_id = posting.document_id;
+    if (auto it = std::lower_bound(removed_.begin(), removed_.end(), document_id);
+        it != removed_.end() && *it == document_id) {
+        // документ удаляли, но его вхождение ещё лежит в основном массиве
+        removed_.erase(it);
+        *LowerBound(postings_, document_id) = posting;
+        return;
+    }
+    if (added_.empty() && (postings_.empty() || postings_.back().document_id < document_id)) {
+        postings_.push_back(posting);
+        return;
+    }
+    added_.insert(LowerBound(added_, document_id), posting);
+    MergeIfNeeded();
+}
+
+void PostingList::AddSorted(const std::vector<Posting>& postings) {
+    if (postings.empty()) {
+        return;
+    }
+    Merge();
+    if (postings_.empty() || postings_.back().document_id < postings.front().document_id) {
+        postings_.insert(postings_.end(), postings.begin(), postings.end());
+        return;
+    }
+    std::vector<Posting> merged;
+    merged.reserve(postings_.size() + postings.size());
+    std::merge(postings_.begin(), postings_.end(), postings.begin(), postings.end(), std::back_inserter(merged),
+               [](const Posting& lhs, const Posting& rhs) { return lhs.document_id < rhs.document_id; });
+    postings_ = std::move(merged);
+}
+
+void PostingList::Remove(int document_id) {
+    if (auto it = LowerBound(added_, document_id);
+        it != added_.end() && it->document_id == document_id) {
+        added_.erase(it);
+        return;
+    }
+    if (auto it = LowerBound(postings_, document_id);
+        it != postings_.end() && it->document_id == document_id) {
+        if (it + 1 == postings_.end() && added_.empty() && removed_.empty()) {
+            postings_.pop_back();
+            return;
+        }
+        removed_.insert(std::lower_bound(removed_.begin(), removed_.end(), document_id), document_id);
+        MergeIfNeeded();
+    }
+}
+
+void PostingList::RemoveSorted(const std::vector<int>& document_ids) {
+    if (document_ids.size() <= GetDeltaLimit()) {
+        for (const int document_id : document_ids) {
+            Remove(document_id);
+        }
+        return;
+    }
+    std::vector<Posting> merged;
+    merged.reserve(size());
+    auto removed = document_ids.begin();
+    ForEach([&](const Posting& posting) {
+        while (removed != document_ids.end() && *removed < posting.document_id) {
+            ++removed;
+        }
+        if (removed == document_ids.end() || *removed != posting.document_id) {
+            merged.push_back(posting);
+        }
+    });
+    postings_ = std::move(merged);
+    added_.clear();
+    removed_.clear();
+}
+
+bool PostingList::Contains(int document_id) const {
+    if (auto it = LowerBound(added_, document_id);
+        it != added_.end() && it->document_id == document_id) {
+        return true;
+    }
+    auto it = LowerBound(postings_, document_id);
+    return it != postings_.end() && it->document_id == document_id
+        && !std::binary_search(removed_.begin(), removed_.end(), document_id);
+}
+
+void PostingList::Merge() {
+    if (added_.empty() && removed_.empty()) {
+        return;
+    }
+    std::vector<Posting> merged;
+    merged.reserve(size());
+    ForEach([&merged](const Posting& posting) {
+        merged.push_back(posting);
+    });
+    postings_ = std::move(merged);
+    added_.clear();
+    removed_.clear();
+}
+
+void PostingList::Compact() {
+    Merge();
+    postings_.shrink_to_fit();
+    added_.shrink_to_fit();
+    removed_.shrink_to_fit();
+}
+
+size_t PostingList::GetDeltaLimit() const {
+    // вставка в дельту стоит O(размер дельты), слияние - O(размер списка),
+    // поэтому держим дельту порядка корня из размера основного массива
+    return std::max(MIN_DELTA_SIZE, static_cast<size_t>(std::sqrt(postings_.size())));
+}
+
+void PostingList::MergeIfNeeded() {
+    if (added_.size() + removed_.size() > GetDeltaLimit()) {
+        Merge();
+    }
+}
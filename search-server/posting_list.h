@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Posting {
+    int document_id;
+    // порядковый номер документа внутри сервера, см. SearchServer::documents_
+    uint32_t ordinal;
+    double term_freq;
+};
+
+// Список вхождений слова: непрерывный массив, отсортированный по id документа.
+// Добавления и удаления сначала попадают в небольшую дельту (added_/removed_),
+// которая вливается в основной массив, когда становится слишком большой.
+class PostingList {
+public:
+    void Add(const Posting& posting);
+
+    // Добавляет отсортированные по id вхождения документов, которых ещё нет в списке,
+    // одним слиянием с основным массивом
+    void AddSorted(const std::vector<Posting>& postings);
+
+    void Remove(int document_id);
+
+    // Удаляет вхождения документов с отсортированными id. Большой пакет вычищается
+    // одним проходом по списку вместо правки дельты по одному документу.
+    void RemoveSorted(const std::vector<int>& document_ids);
+
+    bool Contains(int document_id) const;
+
+    size_t size() const {
+        return postings_.size() + added_.size() - removed_.size();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // Вливает дельту в основной массив
+    void Merge();
+
+    // Вливает дельту и освобождает неиспользуемую ёмкость массивов
+    void Compact();
+
+    // Память под массивы вхождений в байтах
+    size_t GetMemoryUsage() const {
+        return (postings_.capacity() + added_.capacity()) * sizeof(Posting) + removed_.capacity() * sizeof(int);
+    }
+
+    // Обходит вхождения в порядке возрастания id документа,
+    // вызывая function(const Posting&)
+    template <typename Function>
+    void ForEach(Function function) const;
+
+    // То же для документов с id из отрезка [first_document_id, last_document_id]
+    template <typename Function>
+    void ForEach(int first_document_id, int last_document_id, Function function) const;
+
+private:
+    static constexpr size_t MIN_DELTA_SIZE = 32;
+
+    std::vector<Posting> postings_;
+    // новые вхождения, которых нет в postings_, отсортированы по id
+    std::vector<Posting> added_;
+    // id удалённых документов, присутствующих в postings_, отсортированы
+    std::vector<int> removed_;
+
+    // Наибольший размер дельты, при котором её ещё выгоднее держать, чем влить в список
+    size_t GetDeltaLimit() const;
+
+    void MergeIfNeeded();
+
+    using PostingIterator = std::vector<Posting>::const_iterator;
+    using IdIterator = std::vector<int>::const_iterator;
+
+    template <typename Function>
+    static void ForEach(PostingIterator first, PostingIterator last,
+                        PostingIterator added, PostingIterator added_last,
+                        IdIterator removed, IdIterator removed_last, Function& function);
+};
+
+template <typename Function>
+void PostingList::ForEach(Function function) const {
+    ForEach(postings_.begin(), postings_.end(), added_.begin(), added_.end(),
+            removed_.begin(), removed_.end(), function);
+}
+
+template <typename Function>
+void PostingList::ForEach(int first_document_id, int last_document_id, Function function) const {
+    const auto posting_less = [](const Posting& posting, int id) { return posting.document_id < id; };
+    const auto id_less = [](int id, const Posting& posting) { return id < posting.document_id; };
+    ForEach(std::lower_bound(postings_.begin(), postings_.end(), first_document_id, posting_less),
+            std::upper_bound(postings_.begin(), postings_.end(), last_document_id, id_less),
+            std::lower_bound(added_.begin(), added_.end(), first_document_id, posting_less),
+            std::upper_bound(added_.begin(), added_.end(), last_document_id, id_less),
+            std::lower_bound(removed_.begin(), removed_.end(), first_document_id),
+            std::upper_bound(removed_.begin(), removed_.end(), last_document_id),
+            function);
+}
+
+template <typename Function>
+void PostingList::ForEach(PostingIterator first, PostingIterator last,
+                          PostingIterator added, PostingIterator added_last,
+                          IdIterator removed, IdIterator removed_last, Function& function) {
+    for (; first != last; ++first) {
+        for (; added != added_last && added->document_id < first->document_id; ++added) {
+            function(*added);
+        }
+        if (removed != removed_last && *removed == first->document_id) {
+            ++removed;
+            continue;
+        }
+        function(*first);
+    }
+    for (; added != added_last; ++added) {
+        function(*added);
+    }
+}
@@ -1,23 +1,98 @@
 #include "process_queries.h"
 
-std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries){
-    std::vector<std::vector<Document>> result(queries.size());
-    
-    std::transform(std::execution::par, queries.begin(), queries.end(), result.begin(), [&search_server](const std::string& lhs){
-        return search_server.FindTopDocuments(lhs);
+#include <exception>
+#include <numeric>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+
+QueryBatchResult ProcessQueryBatch(const SearchServer& search_server, const std::vector<std::string>& queries) {
+    // одинаковые тексты разбираются один раз
+    std::vector<std::string_view> texts;
+    std::vector<size_t> text_indexes(queries.size());
+    std::unordered_map<std::string_view, size_t> text_positions;
+    text_positions.reserve(queries.size());
+    for (size_t index = 0; index < queries.size(); ++index) {
+        const auto [position, inserted] = text_positions.emplace(queries[index], texts.size());
+        if (inserted) {
+            texts.push_back(queries[index]);
+        }
+        text_indexes[index] = position->second;
+    }
+
+    struct ParsedText {
+        ParsedQuery query;
+        // исключение, вылетевшее из параллельного алгоритма, завершает программу
+        std::exception_ptr error;
+    };
+    std::vector<ParsedText> parsed_texts(texts.size());
+    std::vector<size_t> text_order(texts.size());
+    std::iota(text_order.begin(), text_order.end(), 0);
+    std::for_each(std::execution::par, text_order.begin(), text_order.end(), [&](size_t index) {
+        try {
+            parsed_texts[index].query = search_server.ParseQuery(texts[index]);
+        } catch (...) {
+            parsed_texts[index].error = std::current_exception();
+        }
     });
-    
+    for (const ParsedText& parsed_text : parsed_texts) {
+        if (parsed_text.error) {
+            std::rethrow_exception(parsed_text.error);
+        }
+    }
+
+    // разные тексты с одинаковыми после разбора словами - один запрос
+    const auto key = [&parsed_texts](size_t index) {
+        const ParsedQuery& query = parsed_texts[index].query;
+        return std::tie(query.plus_words, query.minus_words);
+    };
+    std::sort(text_order.begin(), text_order.end(), [&key](size_t lhs, size_t rhs) {
+        return key(lhs) < key(rhs);
+    });
+    std::vector<const ParsedQuery*> distinct_queries;
+    std::vector<size_t> query_indexes(texts.size());
+    for (size_t i = 0; i < text_order.size(); ++i) {
+        if (i == 0 || key(text_order[i - 1]) != key(text_order[i])) {
+            distinct_queries.push_back(&parsed_texts[text_order[i]].query);
+        }
+        query_indexes[text_order[i]] = distinct_queries.size() - 1;
+    }
+
+    // Стоимость запросов сильно разнится, поэтому их делит между потоками планировщик TBB,
+    // на котором построены параллельные алгоритмы: освободившийся поток забирает
+    // часть работы у занятого
+    std::vector<std::vector<Document>> distinct_results(distinct_queries.size());
+    std::vector<size_t> query_order(distinct_queries.size());
+    std::iota(query_order.begin(), query_order.end(), 0);
+    std::for_each(std::execution::par, query_order.begin(), query_order.end(), [&](size_t index) {
+        static thread_local QueryContext context;
+        distinct_results[index] = search_server.FindTopDocuments(context, *distinct_queries[index]);
+    });
+
+    QueryBatchResult result;
+    result.offsets_.reserve(queries.size() + 1);
+    for (const size_t text_index : text_indexes) {
+        result.offsets_.push_back(result.offsets_.back() + distinct_results[query_indexes[text_index]].size());
+    }
+    result.documents_.reserve(result.offsets_.back());
+    for (const size_t text_index : text_indexes) {
+        const std::vector<Document>& documents = distinct_results[query_indexes[text_index]];
+        result.documents_.insert(result.documents_.end(), documents.begin(), documents.end());
+    }
     return result;
 }
 
-std::list<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries){
-    std::list<Document> buff;
-    
-    for (std::vector<Document>& vd : ProcessQueries(search_server, queries)){
-        for(Document& d : vd){
-             buff.push_back(d);
-        }
+std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries){
+    const QueryBatchResult batch = ProcessQueryBatch(search_server, queries);
+    std::vector<std::vector<Document>> result;
+    result.reserve(batch.size());
+    for (size_t index = 0; index < batch.size(); ++index) {
+        const auto documents = batch[index];
+        result.emplace_back(documents.begin(), documents.end());
     }
-    
-    return buff;
-}
\ No newline at end of file
+    return result;
+}
+
+std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries){
+    return ProcessQueryBatch(search_server, queries).ExtractDocuments();
+}
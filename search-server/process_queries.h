@@ -2,11 +2,50 @@
 #include <algorithm>
 #include <execution>
 #include "search_server.h"
-#include <list>
+#include "paginator.h"
+#include <string>
+#include <vector>
 
+// Выдача пакета запросов: документы всех запросов лежат подряд в одном буфере,
+// выдача запроса - отрезок этого буфера
+class QueryBatchResult {
+public:
+    using Range = IteratorRange<std::vector<Document>::const_iterator>;
+
+    size_t size() const {
+        return offsets_.size() - 1;
+    }
+
+    Range operator[](size_t index) const {
+        return {documents_.begin() + offsets_[index], documents_.begin() + offsets_[index + 1]};
+    }
+
+    // Документы всех запросов в порядке запросов
+    const std::vector<Document>& GetDocuments() const {
+        return documents_;
+    }
+
+    std::vector<Document> ExtractDocuments() {
+        return std::move(documents_);
+    }
+
+private:
+    friend QueryBatchResult ProcessQueryBatch(const SearchServer& search_server,
+                                              const std::vector<std::string>& queries);
+
+    std::vector<Document> documents_;
+    std::vector<size_t> offsets_ = {0};
+};
+
+// Ищет по пакету запросов документы со статусом ACTUAL. Одинаковые запросы, в том числе
+// отличающиеся только порядком и повтором слов, разбираются и считаются один раз;
+// разные запросы считаются параллельно. Выбрасывает invalid_argument, если
+// какой-то запрос некорректен.
+QueryBatchResult ProcessQueryBatch(const SearchServer& search_server, const std::vector<std::string>& queries);
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
 
-std::list<Document> ProcessQueriesJoined(
+// Документы всех запросов подряд в порядке запросов
+std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries);
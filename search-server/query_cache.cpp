@@ -0,0 +1,79 @@
+#include "query_cache.h"
+
+#include <algorithm>
+
+using namespace std;
+
+QueryCache::QueryCache(size_t capacity)
+    : shard_capacity_(max<size_t>(1, (capacity + SHARD_COUNT - 1) / SHARD_COUNT))
+    , shards_(SHARD_COUNT) {
+}
+
+bool QueryCache::Find(const ParsedQuery& query, DocumentStatus status, size_t result_count,
+                      uint64_t index_version, vector<Document>& result) {
+    const uint64_t hash = ComputeHash(query, status, result_count);
+    Shard& shard = shards_[hash % SHARD_COUNT];
+    lock_guard guard(shard.mutex);
+    const auto it = shard.index.find(hash);
+    if (it == shard.index.end()) {
+        ++shard.stats.misses;
+        return false;
+    }
+    const Entry& entry = *it->second;
+    // совпадение хеша ещё не означает совпадения запроса
+    if (entry.index_version != index_version || entry.status != status || entry.result_count != result_count
+        || entry.query.plus_words != query.plus_words || entry.query.minus_words != query.minus_words) {
+        ++shard.stats.misses;
+        return false;
+    }
+    ++shard.stats.hits;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    result.assign(entry.documents.begin(), entry.documents.end());
+    return true;
+}
+
+void QueryCache::Insert(const ParsedQuery& query, DocumentStatus status, size_t result_count,
+                        uint64_t index_version, const vector<Document>& result) {
+    const uint64_t hash = ComputeHash(query, status, result_count);
+    Shard& shard = shards_[hash % SHARD_COUNT];
+    lock_guard guard(shard.mutex);
+    if (const auto it = shard.index.find(hash); it != shard.index.end()) {
+        // запись с тем же хешем заменяется, даже если это другой запрос
+        *it->second = {hash, query, status, result_count, index_version, result};
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    if (shard.entries.size() >= shard_capacity_) {
+        shard.index.erase(shard.entries.back().hash);
+        shard.entries.pop_back();
+    }
+    shard.entries.push_front({hash, query, status, result_count, index_version, result});
+    shard.index.emplace(hash, shard.entries.begin());
+}
+
+QueryCacheStats QueryCache::GetStats() const {
+    QueryCacheStats stats;
+    for (const Shard& shard : shards_) {
+        lock_guard guard(shard.mutex);
+        stats.hits += shard.stats.hits;
+        stats.misses += shard.stats.misses;
+    }
+    return stats;
+}
+
+uint64_t QueryCache::ComputeHash(const ParsedQuery& query, DocumentStatus status, size_t result_count) {
+    uint64_t hash = static_cast<uint64_t>(status) * 0x9E3779B97F4A7C15ull ^ result_count;
+    auto add = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+    };
+    for (const TermId term : query.plus_words) {
+        add(term);
+    }
+    // граница между плюс- и минус-словами, чтобы "a -b" и "a b" различались
+    add(UINT64_MAX);
+    for (const TermId term : query.minus_words) {
+        add(term);
+    }
+    return hash;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "document.h"
+#include "query_context.h"
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct QueryCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+// Кэш результатов поиска. Ключ - разобранный запрос (id плюс- и минус-слов без повторов),
+// статус документов и размер выдачи. Результат действителен только для той версии индекса,
+// для которой он посчитан, устаревшие записи вытесняются при следующей вставке.
+// Записи разложены по корзинам с собственными блокировками, в каждой корзине - вытеснение LRU.
+class QueryCache {
+public:
+    explicit QueryCache(size_t capacity);
+
+    // Копирует в result выдачу запроса для версии индекса index_version, если она есть в кэше
+    bool Find(const ParsedQuery& query, DocumentStatus status, size_t result_count,
+              uint64_t index_version, std::vector<Document>& result);
+
+    void Insert(const ParsedQuery& query, DocumentStatus status, size_t result_count,
+                uint64_t index_version, const std::vector<Document>& result);
+
+    QueryCacheStats GetStats() const;
+
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct Entry {
+        uint64_t hash;
+        ParsedQuery query;
+        DocumentStatus status;
+        size_t result_count;
+        uint64_t index_version;
+        std::vector<Document> documents;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        mutable std::mutex mutex;
+        // недавно использованные записи в начале
+        std::list<Entry> entries;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        QueryCacheStats stats;
+    };
+
+    size_t shard_capacity_;
+    std::vector<Shard> shards_;
+
+    static uint64_t ComputeHash(const ParsedQuery& query, DocumentStatus status, size_t result_count);
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "document.h"
+#include "ordinal_set.h"
+#include "relevance_accumulator.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
+
+#include <string_view>
+#include <vector>
+
+// Разобранный запрос: слова, отсутствующие в индексе, отброшены
+struct ParsedQuery {
+    std::vector<TermId> plus_words;
+    std::vector<TermId> minus_words;
+};
+
+// Рабочие буферы поиска для SearchServer::FindTopDocuments.
+// Контекст рассчитан на многократное использование: буферы только растут,
+// поэтому, прогревшись, запрос не выделяет память в куче.
+// Один контекст нельзя использовать из нескольких потоков одновременно.
+class QueryContext {
+public:
+    QueryContext() = default;
+
+private:
+    friend class SearchServer;
+
+    std::vector<std::string_view> words_;
+    ParsedQuery query_;
+    RelevanceAccumulator accumulator_;
+    OrdinalSet excluded_;
+    // документы, разрешённые фильтром по id, и кандидаты узкого фильтра
+    OrdinalSet allowed_;
+    std::vector<uint32_t> candidates_;
+    TopDocuments top_documents_{0};
+    std::vector<Document> result_;
+};
@@ -0,0 +1,92 @@
+#include "query_statistics.h"
+
+#include <algorithm>
+
+using namespace std;
+
+double QueryStats::GetQueriesPerSecond() const {
+    if (period.count() == 0) {
+        return 0.0;
+    }
+    return request_count / chrono::duration<double>(period).count();
+}
+
+chrono::nanoseconds QueryStats::GetLatencyPercentile(double percentile) const {
+    return chrono::nanoseconds(LatencyBins::GetPercentile(latencies, request_count, percentile));
+}
+
+QueryStatistics::QueryStatistics(chrono::nanoseconds window)
+    : bucket_duration_(max<chrono::nanoseconds>(window / BUCKET_COUNT, chrono::nanoseconds(1)))
+    , buckets_(RING_COUNT * BUCKET_COUNT) {
+}
+
+void QueryStatistics::AddRequest(size_t result_count, chrono::nanoseconds latency, Clock::time_point now) {
+    const int64_t epoch = GetEpoch(now);
+    Bucket& bucket = buckets_[GetRing() * BUCKET_COUNT + epoch % BUCKET_COUNT];
+    int64_t bucket_epoch = bucket.epoch.load(memory_order_acquire);
+    const bool stale = bucket_epoch != epoch;
+    if (stale) {
+        // корзину обнуляет только захвативший её поток, остальные пропускают запрос
+        if (bucket_epoch == RESETTING_EPOCH || bucket_epoch > epoch
+            || !bucket.epoch.compare_exchange_strong(bucket_epoch, RESETTING_EPOCH, memory_order_acq_rel)) {
+            return;
+        }
+        for (auto& count : bucket.result_counts) {
+            count.store(0, memory_order_relaxed);
+        }
+        for (auto& count : bucket.latencies) {
+            count.store(0, memory_order_relaxed);
+        }
+    }
+    const size_t result_bin = min(result_count, RESULT_COUNT_BIN_COUNT - 1);
+    bucket.result_counts[result_bin].fetch_add(1, memory_order_relaxed);
+    const size_t latency_bin = min(LatencyBins::GetBin(max<int64_t>(latency.count(), 0)), LATENCY_BIN_COUNT - 1);
+    bucket.latencies[latency_bin].fetch_add(1, memory_order_relaxed);
+    if (stale) {
+        bucket.epoch.store(epoch, memory_order_release);
+    }
+}
+
+QueryStats QueryStatistics::GetStats(Clock::time_point now) const {
+    const int64_t epoch = GetEpoch(now);
+    QueryStats stats;
+    stats.period = bucket_duration_ * (BUCKET_COUNT - 1) + (now.time_since_epoch() - bucket_duration_ * epoch);
+    QueryStats bucket_stats;
+    for (const Bucket& bucket : buckets_) {
+        const int64_t bucket_epoch = bucket.epoch.load(memory_order_acquire);
+        // сюда попадают и неиспользованные и обнуляемые корзины с отрицательными номерами
+        if (bucket_epoch > epoch || bucket_epoch <= epoch - static_cast<int64_t>(BUCKET_COUNT)) {
+            continue;
+        }
+        for (size_t bin = 0; bin < RESULT_COUNT_BIN_COUNT; ++bin) {
+            bucket_stats.result_counts[bin] = bucket.result_counts[bin].load(memory_order_relaxed);
+        }
+        for (size_t bin = 0; bin < LATENCY_BIN_COUNT; ++bin) {
+            bucket_stats.latencies[bin] = bucket.latencies[bin].load(memory_order_relaxed);
+        }
+        // пока счётчики читались, корзину могли обнулить под новый отрезок
+        atomic_thread_fence(memory_order_acquire);
+        if (bucket.epoch.load(memory_order_relaxed) != bucket_epoch) {
+            continue;
+        }
+        for (size_t bin = 0; bin < RESULT_COUNT_BIN_COUNT; ++bin) {
+            stats.result_counts[bin] += bucket_stats.result_counts[bin];
+            stats.request_count += bucket_stats.result_counts[bin];
+        }
+        for (size_t bin = 0; bin < LATENCY_BIN_COUNT; ++bin) {
+            stats.latencies[bin] += bucket_stats.latencies[bin];
+        }
+    }
+    return stats;
+}
+
+int64_t QueryStatistics::GetEpoch(Clock::time_point time) const {
+    return time.time_since_epoch() / bucket_duration_;
+}
+
+size_t QueryStatistics::GetRing() {
+    // потоки получают кольца по кругу, чтобы соседние потоки не делили кольцо
+    static atomic<size_t> next_ring = 0;
+    static thread_local const size_t ring = next_ring.fetch_add(1, memory_order_relaxed) % RING_COUNT;
+    return ring;
+}
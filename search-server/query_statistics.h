@@ -0,0 +1,78 @@
+#pragma once
+
+#include "log_linear_bins.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Гистограммы числа найденных документов и задержки
+const size_t RESULT_COUNT_BIN_COUNT = 16;
+// Задержка в наносекундах: четыре корзины на каждую степень двойки, то есть погрешность
+// не больше четверти; всё дольше 2^40 нс (около 18 минут) попадает в последнюю корзину
+using LatencyBins = LogLinearBins<4>;
+const size_t LATENCY_BIN_COUNT = LatencyBins::GetBinCount(40);
+
+struct QueryStats {
+    // отрезок времени, за который собрана статистика
+    std::chrono::nanoseconds period{0};
+    uint64_t request_count = 0;
+    // result_counts[k] - число запросов, нашедших k документов, последняя корзина -
+    // RESULT_COUNT_BIN_COUNT - 1 документов и больше
+    std::array<uint64_t, RESULT_COUNT_BIN_COUNT> result_counts{};
+    std::array<uint64_t, LATENCY_BIN_COUNT> latencies{};
+
+    uint64_t GetNoResultCount() const {
+        return result_counts[0];
+    }
+
+    double GetQueriesPerSecond() const;
+
+    // Задержка, которую не превысили percentile процентов запросов (верхняя граница корзины)
+    std::chrono::nanoseconds GetLatencyPercentile(double percentile) const;
+};
+
+// Статистика запросов за скользящее окно реального времени. Окно поделено на корзины
+// по времени, у каждого потока своё кольцо корзин (потоков больше, чем колец, - кольцо
+// делят несколько потоков), при чтении кольца складываются. Запись не берёт блокировок:
+// счётчики атомарные, а устаревшую корзину обнуляет тот поток, который первым её захватил.
+// Запросы, попавшие в корзину в момент её обнуления другим потоком, не учитываются.
+class QueryStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit QueryStatistics(std::chrono::nanoseconds window = std::chrono::minutes(1));
+
+    void AddRequest(size_t result_count, std::chrono::nanoseconds latency, Clock::time_point now = Clock::now());
+
+    // Статистика за последние window; окно сдвигается целыми корзинами, поэтому в неё
+    // попадает от (BUCKET_COUNT - 1) / BUCKET_COUNT окна до целого окна
+    QueryStats GetStats(Clock::time_point now = Clock::now()) const;
+
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t BUCKET_COUNT = 16;
+    static constexpr size_t RING_COUNT = 16;
+    // корзина ещё не использовалась
+    static constexpr int64_t NO_EPOCH = -1;
+    // корзину сейчас обнуляют
+    static constexpr int64_t RESETTING_EPOCH = -2;
+
+    struct alignas(CACHE_LINE_SIZE) Bucket {
+        // номер отрезка времени длиной bucket_duration_, к которому относятся счётчики
+        std::atomic<int64_t> epoch = NO_EPOCH;
+        std::array<std::atomic<uint64_t>, RESULT_COUNT_BIN_COUNT> result_counts;
+        std::array<std::atomic<uint64_t>, LATENCY_BIN_COUNT> latencies;
+    };
+
+    std::chrono::nanoseconds bucket_duration_;
+    // RING_COUNT колец по BUCKET_COUNT корзин
+    std::vector<Bucket> buckets_;
+
+    int64_t GetEpoch(Clock::time_point time) const;
+
+    static size_t GetRing();
+};
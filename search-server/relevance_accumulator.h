@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Плотный аккумулятор релевантности, индексируемый порядковым номером документа.
+// Помнит список затронутых документов, поэтому очистка стоит O(число совпадений),
+// а не O(числа документов). Рассчитан на повторное использование между запросами.
+class RelevanceAccumulator {
+public:
+    // Очищает результаты предыдущего запроса и готовит аккумулятор
+    // для документов с порядковыми номерами [0, ordinal_count)
+    void Reset(size_t ordinal_count) {
+        for (const uint32_t ordinal : touched_) {
+            relevance_[ordinal] = 0.0;
+            state_[ordinal] = State::UNTOUCHED;
+        }
+        touched_.clear();
+        if (relevance_.size() < ordinal_count) {
+            relevance_.resize(ordinal_count, 0.0);
+            state_.resize(ordinal_count, State::UNTOUCHED);
+        }
+    }
+
+    void Add(uint32_t ordinal, double relevance) {
+        if (state_[ordinal] == State::UNTOUCHED) {
+            state_[ordinal] = State::TOUCHED;
+            touched_.push_back(ordinal);
+        }
+        relevance_[ordinal] += relevance;
+    }
+
+    // Вызывает function(ordinal, relevance) для набравших релевантность документов
+    template <typename Function>
+    void ForEach(Function function) const {
+        for (const uint32_t ordinal : touched_) {
+            function(ordinal, relevance_[ordinal]);
+        }
+    }
+
+private:
+    enum class State : uint8_t {
+        UNTOUCHED,
+        TOUCHED,
+    };
+
+    std::vector<double> relevance_;
+    std::vector<State> state_;
+    std::vector<uint32_t> touched_;
+};
@@ -1,21 +1,227 @@
 #include "remove_duplicates.h"
 
-void RemoveDuplicates(SearchServer& search_server){
-    std::vector<int> duplicates_id;
-    std::set<std::set<std::string>> list;
-    for (auto id = search_server.begin(); id != search_server.end(); ++id){
-        std::map<std::string, double> words_in_doc = search_server.GetWordFrequencies(*id);
-        std::set<std::string> words;
-        for (auto [word, freq] : words_in_doc){
-            words.insert(word);
-        }
-        auto emplace = list.emplace(words);
-        if (!emplace.second){
-            duplicates_id.push_back(*id);
-        } 
-    }
-    for (int id : duplicates_id){
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+
+// Длина MinHash-сигнатуры документа
+constexpr size_t MINHASH_SIZE = 128;
+
+// Финализатор splitmix64
+uint64_t MixHash(uint64_t value) {
+    value += 0x9e3779b97f4a7c15;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+    return value ^ (value >> 31);
+}
+
+void GetDocumentTerms(const SearchServer& search_server, int document_id, std::vector<TermId>& terms) {
+    terms.clear();
+    search_server.ForEachDocumentTerm(document_id, [&terms](TermId term) {
+        terms.push_back(term);
+    });
+}
+
+std::vector<int> FindExactDuplicates(const SearchServer& search_server, const std::vector<int>& document_ids) {
+    // сумма хешей слов не зависит от их порядка, а слова документа не повторяются
+    std::vector<std::array<uint64_t, 2>> fingerprints(document_ids.size());
+    std::vector<size_t> indexes(document_ids.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+        std::array<uint64_t, 2> fingerprint = {0, 0};
+        search_server.ForEachDocumentTerm(document_ids[index], [&fingerprint](TermId term) {
+            const uint64_t hash = MixHash(term);
+            fingerprint[0] += hash;
+            fingerprint[1] += MixHash(hash);
+        });
+        fingerprints[index] = fingerprint;
+    });
+    // документы с равными отпечатками оказываются рядом и внутри группы идут по возрастанию id
+    std::sort(std::execution::par, indexes.begin(), indexes.end(), [&fingerprints](size_t lhs, size_t rhs) {
+        return std::tie(fingerprints[lhs], lhs) < std::tie(fingerprints[rhs], rhs);
+    });
+
+    std::vector<int> duplicates;
+    std::vector<std::vector<TermId>> kept_terms;
+    std::vector<TermId> terms;
+    for (size_t group_begin = 0, group_end = 0; group_begin < indexes.size(); group_begin = group_end) {
+        group_end = group_begin + 1;
+        while (group_end < indexes.size() && fingerprints[indexes[group_end]] == fingerprints[indexes[group_begin]]) {
+            ++group_end;
+        }
+        if (group_end - group_begin == 1) {
+            continue;
+        }
+        // совпадение отпечатков проверяется сравнением наборов слов
+        kept_terms.clear();
+        for (size_t i = group_begin; i < group_end; ++i) {
+            const int document_id = document_ids[indexes[i]];
+            GetDocumentTerms(search_server, document_id, terms);
+            if (std::find(kept_terms.begin(), kept_terms.end(), terms) != kept_terms.end()) {
+                duplicates.push_back(document_id);
+            } else {
+                kept_terms.push_back(terms);
+            }
+        }
+    }
+    std::sort(duplicates.begin(), duplicates.end());
+    return duplicates;
+}
+
+double ComputeJaccardSimilarity(const std::vector<TermId>& lhs, const std::vector<TermId>& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1.0;
+    }
+    size_t common = 0;
+    for (auto lhs_it = lhs.begin(), rhs_it = rhs.begin(); lhs_it != lhs.end() && rhs_it != rhs.end();) {
+        if (*lhs_it < *rhs_it) {
+            ++lhs_it;
+        } else if (*rhs_it < *lhs_it) {
+            ++rhs_it;
+        } else {
+            ++common;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    return static_cast<double>(common) / (lhs.size() + rhs.size() - common);
+}
+
+// Сигнатура делится на полосы по rows значений, документы с совпавшей полосой сравниваются точно.
+// Пара с похожестью s совпадает хотя бы в одной полосе с вероятностью 1 - (1 - s^rows)^bands.
+// Выбирается самое узкое разбиение, на котором пара с похожестью, равной порогу,
+// находится с вероятностью не меньше MIN_RECALL; более похожие пары - с большей.
+size_t ChooseBandRows(double similarity_threshold) {
+    constexpr double MIN_RECALL = 0.9;
+    size_t band_rows = 1;
+    for (size_t rows = 1; rows <= MINHASH_SIZE; ++rows) {
+        const size_t bands = MINHASH_SIZE / rows;
+        if (1.0 - std::pow(1.0 - std::pow(similarity_threshold, rows), bands) >= MIN_RECALL) {
+            band_rows = rows;
+        }
+    }
+    return band_rows;
+}
+
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, const std::vector<int>& document_ids,
+                                    double similarity_threshold) {
+    const size_t band_rows = ChooseBandRows(similarity_threshold);
+    const size_t band_count = MINHASH_SIZE / band_rows;
+    // хеши полос документов; сигнатуры целиком не хранятся
+    std::vector<uint64_t> band_hashes(document_ids.size() * band_count);
+    // k-я функция сигнатуры: хеш слова, смешанный с k-м зерном одним умножением
+    std::array<uint64_t, MINHASH_SIZE> seeds;
+    for (size_t k = 0; k < MINHASH_SIZE; ++k) {
+        seeds[k] = MixHash(k);
+    }
+    std::vector<size_t> indexes(document_ids.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+        std::array<uint64_t, MINHASH_SIZE> signature;
+        signature.fill(std::numeric_limits<uint64_t>::max());
+        search_server.ForEachDocumentTerm(document_ids[index], [&](TermId term) {
+            const uint64_t hash = MixHash(term);
+            for (size_t k = 0; k < MINHASH_SIZE; ++k) {
+                signature[k] = std::min(signature[k], (hash ^ seeds[k]) * 0xff51afd7ed558ccd);
+            }
+        });
+        for (size_t band = 0; band < band_count; ++band) {
+            uint64_t band_hash = band;
+            for (size_t row = 0; row < band_rows; ++row) {
+                band_hash = MixHash(band_hash ^ signature[band * band_rows + row]);
+            }
+            band_hashes[index * band_count + band] = band_hash;
+        }
+    });
+
+    // Документы с совпавшей полосой образуют группу. Почти все полосы уникальны,
+    // поэтому для каждого документа запоминаются только группы, где он не один.
+    std::vector<std::pair<uint32_t, uint32_t>> memberships;
+    size_t group_count = 0;
+    std::vector<std::pair<uint64_t, uint32_t>> band_entries(document_ids.size());
+    for (size_t band = 0; band < band_count; ++band) {
+        for (uint32_t index = 0; index < document_ids.size(); ++index) {
+            band_entries[index] = {band_hashes[index * band_count + band], index};
+        }
+        std::sort(std::execution::par, band_entries.begin(), band_entries.end());
+        for (size_t group_begin = 0, group_end = 0; group_begin < band_entries.size(); group_begin = group_end) {
+            group_end = group_begin + 1;
+            while (group_end < band_entries.size() && band_entries[group_end].first == band_entries[group_begin].first) {
+                ++group_end;
+            }
+            if (group_end - group_begin > 1) {
+                for (size_t i = group_begin; i < group_end; ++i) {
+                    memberships.push_back({band_entries[i].second, static_cast<uint32_t>(group_count)});
+                }
+                ++group_count;
+            }
+        }
+    }
+    std::sort(std::execution::par, memberships.begin(), memberships.end());
+
+    // документы просматриваются по возрастанию id и сравниваются только с оставленными
+    // документами своих групп
+    std::vector<std::vector<uint32_t>> kept_members(group_count);
+    std::vector<int> duplicates;
+    std::vector<uint32_t> candidates;
+    std::vector<TermId> terms;
+    std::vector<TermId> candidate_terms;
+    for (auto membership = memberships.begin(); membership != memberships.end();) {
+        const uint32_t index = membership->first;
+        const auto last_membership = std::find_if(membership, memberships.end(), [index](const auto& entry) {
+            return entry.first != index;
+        });
+        candidates.clear();
+        for (auto it = membership; it != last_membership; ++it) {
+            const auto& members = kept_members[it->second];
+            candidates.insert(candidates.end(), members.begin(), members.end());
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        bool is_duplicate = false;
+        if (!candidates.empty()) {
+            GetDocumentTerms(search_server, document_ids[index], terms);
+            for (const uint32_t candidate : candidates) {
+                GetDocumentTerms(search_server, document_ids[candidate], candidate_terms);
+                if (ComputeJaccardSimilarity(terms, candidate_terms) >= similarity_threshold) {
+                    is_duplicate = true;
+                    break;
+                }
+            }
+        }
+        if (is_duplicate) {
+            duplicates.push_back(document_ids[index]);
+        } else {
+            for (auto it = membership; it != last_membership; ++it) {
+                kept_members[it->second].push_back(index);
+            }
+        }
+        membership = last_membership;
+    }
+    return duplicates;
+}
+
+}  // namespace
+
+std::vector<int> FindDuplicates(const SearchServer& search_server, double similarity_threshold) {
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    if (similarity_threshold >= 1.0) {
+        return FindExactDuplicates(search_server, document_ids);
+    }
+    return FindNearDuplicates(search_server, document_ids, similarity_threshold);
+}
+
+void RemoveDuplicates(SearchServer& search_server, double similarity_threshold) {
+    const std::vector<int> duplicates = FindDuplicates(search_server, similarity_threshold);
+    for (const int id : duplicates) {
         std::cout << "Duplicate document id: "s << id << std::endl;
-        search_server.RemoveDocument(id);
     }
-}
\ No newline at end of file
+    search_server.RemoveDocuments(duplicates);
+}
@@ -2,5 +2,15 @@
 
 #include "search_server.h"
 
- void RemoveDuplicates(SearchServer& search_server);
- 
\ No newline at end of file
+#include <vector>
+
+// Id документов, повторяющих набор слов документа с меньшим id, по возрастанию.
+// Наборы слов сравниваются по 128-битным отпечаткам и точно - только при совпадении отпечатков.
+// При similarity_threshold < 1 дубликатом считается и документ, у которого коэффициент
+// Жаккара наборов слов с оставленным документом с меньшим id не ниже порога. Такие пары
+// ищутся по MinHash-сигнатурам (LSH): пара с похожестью, равной порогу, находится
+// с вероятностью не меньше 0.9, более похожие - почти наверняка.
+std::vector<int> FindDuplicates(const SearchServer& search_server, double similarity_threshold = 1.0);
+
+// Удаляет документы FindDuplicates, печатая их id
+void RemoveDuplicates(SearchServer& search_server, double similarity_threshold = 1.0);
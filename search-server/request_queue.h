@@ -1,10 +1,13 @@
 #pragma once
-#include <deque>
+#include "query_statistics.h"
 #include "search_server.h"
 
+// Ищет документы и собирает статистику запросов за скользящее окно реального времени.
+// Можно вызывать из многих потоков одновременно: учёт запроса не берёт блокировок.
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server);
+    explicit RequestQueue(const SearchServer& search_server,
+                          std::chrono::nanoseconds window = std::chrono::hours(24));
     
     template <typename DocumentPredicate>
     vector<Document> AddFindRequest(const string& raw_query, DocumentPredicate document_predicate);
@@ -13,25 +16,32 @@ public:
     
     vector<Document> AddFindRequest(const string& raw_query);
     
+    // Число запросов без результатов за окно
     int GetNoResultRequests() const;
     
+    QueryStats GetStats() const;
+    
 private:
-    struct QueryResult {
-        uint64_t timestamp;
-        int results;
-    };
-    deque<QueryResult> requests_;
     const SearchServer& search_server_;
-    int no_results_requests_;
-    uint64_t current_time_;
-    const static int min_in_day_ = 1440;
- 
-    void AddRequest(int results_num);
+    QueryStatistics statistics_;
+    
+    // Выполняет find() и учитывает запрос в статистике
+    template <typename Function>
+    vector<Document> AddRequest(Function find);
 };
 
 template <typename DocumentPredicate>
     vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentPredicate document_predicate) {
-        const auto result = search_server_.FindTopDocuments(raw_query, document_predicate);
-        AddRequest(result.size());
+        return AddRequest([&]() {
+            return search_server_.FindTopDocuments(raw_query, document_predicate);
+        });
+    }
+
+template <typename Function>
+    vector<Document> RequestQueue::AddRequest(Function find) {
+        const auto start_time = QueryStatistics::Clock::now();
+        auto result = find();
+        const auto end_time = QueryStatistics::Clock::now();
+        statistics_.AddRequest(result.size(), end_time - start_time, end_time);
         return result;
-    }
\ No newline at end of file
+    }
@@ -9,62 +9,269 @@ SearchServer::SearchServer(string_view stop_words_text) : SearchServer(SplitInto
 
 void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status,
                      const vector<int>& ratings) {
-        if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+        PROFILE_DURATION("index.add_document"s);
+        if ((document_id < 0) || (document_ordinals_.count(document_id) > 0)) {
             throw invalid_argument("Invalid document_id"s);
         }
-        storage_.emplace_back(document);
-        const auto words = SplitIntoWordsNoStop(storage_.back());
-        const double inv_word_count = 1.0 / words.size();
-        for (string_view word : words) {
-            word_to_document_freqs_[word][document_id] += inv_word_count;
-            word_freqs_by_id_[document_id][word] += inv_word_count;
+        const auto document_word_freqs = ComputeWordFrequencies(document);
+        const uint32_t ordinal = AllocateOrdinal({document_id, ComputeAverageRating(ratings), status, true});
+        document_ordinals_.emplace(document_id, ordinal);
+        auto& document_terms = document_terms_[ordinal];
+        document_terms.reserve(document_word_freqs.size());
+        for (const auto [word, term_freq] : document_word_freqs) {
+            const TermId term = terms_.Acquire(word);
+            if (term >= term_data_.size()) {
+                term_data_.resize(terms_.IdBound());
+            }
+            term_data_[term].postings.Add({document_id, ordinal, term_freq});
+            ++term_data_[term].document_count;
+            document_terms.push_back({term, term_freq});
         }
-        documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+        sort(document_terms.begin(), document_terms.end(),
+             [](const TermFrequency& lhs, const TermFrequency& rhs) { return lhs.term < rhs.term; });
         document_ids_.insert(document_id);
+        mutable_ordinals_.push_back(ordinal);
+        ++index_version_;
+        if (mutable_ordinals_.size() >= segment_document_count_) {
+            FlushMutableSegment();
+        }
+    }
+
+    void SearchServer::AddDocuments(const vector<NewDocument>& documents) {
+        AddDocumentsBatch(std::execution::seq, documents);
+    }
+
+    void SearchServer::AddDocuments(const std::execution::sequenced_policy&, const vector<NewDocument>& documents) {
+        AddDocumentsBatch(std::execution::seq, documents);
+    }
+
+    void SearchServer::AddDocuments(const std::execution::parallel_policy&, const vector<NewDocument>& documents) {
+        AddDocumentsBatch(std::execution::par, documents);
+    }
+
+    template <typename ExecutionPolicy>
+    void SearchServer::AddDocumentsBatch(const ExecutionPolicy& policy, const vector<NewDocument>& documents) {
+        PROFILE_DURATION("index.add_documents"s);
+        unordered_set<int> batch_ids;
+        for (const NewDocument& document : documents) {
+            if (document.id < 0 || document_ordinals_.count(document.id) > 0 || !batch_ids.insert(document.id).second) {
+                throw invalid_argument("Invalid document_id"s);
+            }
+        }
+
+        // Пакет делится на части, каждая часть разбирается отдельно и строит частичный
+        // обратный индекс: слово -> (номер документа в пакете, TF) по возрастанию номера
+        struct ChunkTerm {
+            TermId term = TermDictionary::NO_TERM;
+            vector<pair<size_t, double>> postings;
+        };
+        struct Chunk {
+            size_t first;
+            size_t last;
+            // слова документов части со ссылками на частичный индекс
+            vector<vector<pair<const ChunkTerm*, double>>> document_terms;
+            unordered_map<string_view, ChunkTerm> terms;
+            exception_ptr error;
+        };
+        const size_t chunk_count = min<size_t>(documents.size(), 4 * max(1u, thread::hardware_concurrency()));
+        vector<Chunk> chunks(chunk_count);
+        for (size_t i = 0; i < chunk_count; ++i) {
+            chunks[i].first = documents.size() * i / chunk_count;
+            chunks[i].last = documents.size() * (i + 1) / chunk_count;
+        }
+        for_each(policy, chunks.begin(), chunks.end(), [&](Chunk& chunk) {
+            // исключение, вылетевшее из параллельного алгоритма, завершает программу
+            try {
+                chunk.document_terms.resize(chunk.last - chunk.first);
+                for (size_t index = chunk.first; index < chunk.last; ++index) {
+                    auto& document_terms = chunk.document_terms[index - chunk.first];
+                    for (const auto [word, term_freq] : ComputeWordFrequencies(documents[index].text)) {
+                        ChunkTerm& chunk_term = chunk.terms[word];
+                        chunk_term.postings.push_back({index, term_freq});
+                        document_terms.push_back({&chunk_term, term_freq});
+                    }
+                }
+            } catch (...) {
+                chunk.error = current_exception();
+            }
+        });
+        for (const Chunk& chunk : chunks) {
+            if (chunk.error) {
+                rethrow_exception(chunk.error);
+            }
+        }
+
+        // Дальше пакет корректен и индекс меняется. Большой пакет сразу становится
+        // неизменяемым сегментом, минуя изменяемый.
+        const bool is_segment = documents.size() >= segment_document_count_;
+        vector<uint32_t> ordinals(documents.size());
+        for (size_t index = 0; index < documents.size(); ++index) {
+            const NewDocument& document = documents[index];
+            ordinals[index] = AllocateOrdinal({document.id, ComputeAverageRating(document.ratings), document.status,
+                                               !is_segment});
+            document_ordinals_.emplace(document.id, ordinals[index]);
+            document_ids_.insert(document.id);
+        }
+
+        // Частичные индексы сливаются по словам
+        vector<pair<TermId, vector<Posting>>> term_postings;
+        unordered_map<TermId, size_t> term_positions;
+        for (Chunk& chunk : chunks) {
+            for (auto& [word, chunk_term] : chunk.terms) {
+                chunk_term.term = terms_.Acquire(word, chunk_term.postings.size());
+                const auto [position, inserted] = term_positions.emplace(chunk_term.term, term_postings.size());
+                if (inserted) {
+                    term_postings.push_back({chunk_term.term, {}});
+                }
+                auto& new_postings = term_postings[position->second].second;
+                for (const auto& [index, term_freq] : chunk_term.postings) {
+                    new_postings.push_back({documents[index].id, ordinals[index], term_freq});
+                }
+            }
+        }
+        term_data_.resize(max(term_data_.size(), terms_.IdBound()));
+        for (const auto& [term, postings] : term_postings) {
+            term_data_[term].document_count += postings.size();
+        }
+        // списки вхождений разных слов независимы
+        for_each(policy, term_postings.begin(), term_postings.end(), [this, is_segment](auto& term_and_postings) {
+            auto& [term, postings] = term_and_postings;
+            // изменяемый сегмент упорядочен по id документа, неизменяемый - по порядковому номеру
+            if (is_segment) {
+                sort(postings.begin(), postings.end(),
+                     [](const Posting& lhs, const Posting& rhs) { return lhs.ordinal < rhs.ordinal; });
+            } else {
+                sort(postings.begin(), postings.end(),
+                     [](const Posting& lhs, const Posting& rhs) { return lhs.document_id < rhs.document_id; });
+                term_data_[term].postings.AddSorted(postings);
+            }
+        });
+        if (is_segment) {
+            sort(term_postings.begin(), term_postings.end(),
+                 [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+            SegmentBuilder builder;
+            for (auto& [term, postings] : term_postings) {
+                for (const Posting& posting : postings) {
+                    builder.Add(term, posting.ordinal, posting.term_freq);
+                }
+                vector<Posting>().swap(postings);
+            }
+            vector<uint32_t> segment_ordinals = ordinals;
+            sort(segment_ordinals.begin(), segment_ordinals.end());
+            segments_->AddSegment(builder.Build(move(segment_ordinals)));
+        }
+        for_each(policy, chunks.begin(), chunks.end(), [&](const Chunk& chunk) {
+            for (size_t index = chunk.first; index < chunk.last; ++index) {
+                auto& document_terms = document_terms_[ordinals[index]];
+                document_terms.reserve(chunk.document_terms[index - chunk.first].size());
+                for (const auto& [chunk_term, term_freq] : chunk.document_terms[index - chunk.first]) {
+                    document_terms.push_back({chunk_term->term, term_freq});
+                }
+                sort(document_terms.begin(), document_terms.end(),
+                     [](const TermFrequency& lhs, const TermFrequency& rhs) { return lhs.term < rhs.term; });
+            }
+        });
+        ++index_version_;
+        if (!is_segment) {
+            mutable_ordinals_.insert(mutable_ordinals_.end(), ordinals.begin(), ordinals.end());
+            if (mutable_ordinals_.size() >= segment_document_count_) {
+                FlushMutableSegment();
+            }
+        }
     }
 
     vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {  
-        return FindTopDocuments(std::execution::seq, raw_query, [status](int document_id, DocumentStatus document_status, int rating) { 
-                return document_status == status; 
-            });
+        return FindTopDocuments(std::execution::seq, raw_query, status);
     } 
   
     vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const { 
         return FindTopDocuments(raw_query, DocumentStatus::ACTUAL); 
     }
 
+    const vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, string_view raw_query,
+                                                           DocumentStatus status) const {
+        ParseQuery(raw_query, context.words_, context.query_);
+        FindDocumentsByStatus(context, status);
+        return context.result_;
+    }
+
+    const vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, const ParsedQuery& query,
+                                                           DocumentStatus status) const {
+        context.query_.plus_words.assign(query.plus_words.begin(), query.plus_words.end());
+        context.query_.minus_words.assign(query.minus_words.begin(), query.minus_words.end());
+        FindDocumentsByStatus(context, status);
+        return context.result_;
+    }
+
+    void SearchServer::FindDocumentsByStatus(QueryContext& context, DocumentStatus status) const {
+        if (!query_cache_) {
+            FindFilteredDocuments(context, CompileStatusFilter(status));
+            return;
+        }
+        if (!query_cache_->Find(context.query_, status, max_result_document_count_, index_version_, context.result_)) {
+            FindFilteredDocuments(context, CompileStatusFilter(status));
+            query_cache_->Insert(context.query_, status, max_result_document_count_, index_version_, context.result_);
+        }
+    }
+
+    const vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, string_view raw_query) const {
+        return FindTopDocuments(context, raw_query, DocumentStatus::ACTUAL);
+    }
+
+    vector<Document> SearchServer::FindTopDocuments(string_view raw_query, const DocumentFilter& filter) const {
+        return FindTopDocuments(std::execution::seq, raw_query, filter);
+    }
+
+    const vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, string_view raw_query,
+                                                           const DocumentFilter& filter) const {
+        ParseQuery(raw_query, context.words_, context.query_);
+        FindFilteredDocuments(context, CompileFilter(filter, context));
+        return context.result_;
+    }
+
     int SearchServer::GetDocumentCount() const {
-        return documents_.size();
+        return document_ordinals_.size();
+    }
+
+    void SearchServer::SetMaxResultDocumentCount(size_t count) {
+        max_result_document_count_ = count;
+    }
+
+    size_t SearchServer::GetMaxResultDocumentCount() const {
+        return max_result_document_count_;
+    }
+
+    void SearchServer::SetQueryCacheCapacity(size_t capacity) {
+        if (capacity == 0) {
+            query_cache_.reset();
+        } else {
+            query_cache_ = make_unique<QueryCache>(capacity);
+        }
+    }
+
+    QueryCacheStats SearchServer::GetQueryCacheStats() const {
+        return query_cache_ ? query_cache_->GetStats() : QueryCacheStats{};
+    }
+
+    void SearchServer::SetDynamicPruning(bool enabled) {
+        dynamic_pruning_ = enabled;
+    }
+
+    void SearchServer::SetSegmentDocumentCount(size_t count) {
+        segment_document_count_ = max<size_t>(count, 1);
+        if (mutable_ordinals_.size() >= segment_document_count_) {
+            FlushMutableSegment();
+        }
     }
  
     tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query,
                                                         int document_id) const {
-        Query query = ParseQuery(false,raw_query);
-
-        std::vector<std::string_view> plus_words_document;
-        for (const std::string_view& word : query.minus_words) {
-            if (word_to_document_freqs_.count(word)) {
-                if (word_to_document_freqs_.at(word).count(document_id)) {
-                    DocumentStatus status = documents_.at(document_id).status;
-                    std::tuple<std::vector<std::string_view>, DocumentStatus> result = { plus_words_document, status };
-                    return result;
-                    
-                }
-            }
-        }
-        for (const std::string_view& word : query.plus_words) {
-            if (word_to_document_freqs_.count(word)) {
-                if (word_to_document_freqs_.at(word).count(document_id)) {
-                    plus_words_document.push_back(word);
-                }
-            }
-        }
-        
-        sort(plus_words_document.begin(), plus_words_document.end());
-
-        DocumentStatus status = documents_.at(document_id).status;
-        std::tuple<std::vector<std::string_view>, DocumentStatus> result = { plus_words_document, status };
-        return result;
+        QueryContext& context = GetThreadContext();
+        ParseQuery(raw_query, context.words_, context.query_);
+        const uint32_t ordinal = document_ordinals_.at(document_id);
+        vector<string_view> plus_words_document;
+        MatchTerms(context.query_, ordinal, plus_words_document);
+        return {plus_words_document, documents_[ordinal].status};
     }
     
     tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy&, string_view raw_query, int document_id) const{
@@ -72,74 +279,427 @@ void SearchServer::AddDocument(int document_id, std::string_view document, Docum
     }
 
     tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy&, string_view raw_query, int document_id) const{
-        
-       Query query = ParseQuery(true,raw_query);
-        
-        std::vector<std::string_view> plus_words_document;
-
-        if (!std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), 
-            [this,document_id](const std::string_view& word)
-            {
-                return word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id);
-            })) 
-        {
-            plus_words_document.resize(query.plus_words.size());
-            auto it = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), plus_words_document.begin(), 
-                [this,document_id](const std::string_view& word)
-                {
-                    return word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id);
-                });
-            plus_words_document.erase(it, plus_words_document.end());
-            VectorEraseDuplicate(std::execution::par, plus_words_document);
-        }
+        // пересечение запроса со словами одного документа слишком мало, чтобы делить его между потоками
+        return MatchDocument(raw_query, document_id);
+    }
 
-    return {plus_words_document, documents_.at(document_id).status};
+    vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(string_view raw_query,
+                                                                                   const vector<int>& document_ids) const {
+        QueryContext& context = GetThreadContext();
+        ParseQuery(raw_query, context.words_, context.query_);
+        vector<uint32_t> ordinals;
+        ordinals.reserve(document_ids.size());
+        for (const int document_id : document_ids) {
+            ordinals.push_back(document_ordinals_.at(document_id));
+        }
+        vector<tuple<vector<string_view>, DocumentStatus>> result;
+        result.reserve(ordinals.size());
+        for (const uint32_t ordinal : ordinals) {
+            vector<string_view> plus_words_document;
+            MatchTerms(context.query_, ordinal, plus_words_document);
+            result.emplace_back(move(plus_words_document), documents_[ordinal].status);
+        }
+        return result;
     }
 
-    const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const{
-        if (auto res = word_freqs_by_id_.find(document_id); res != word_freqs_by_id_.end()){
-            return res->second;
+    map<string_view, double> SearchServer::GetWordFrequencies(int document_id) const{
+        map<string_view, double> word_freqs;
+        if (auto ordinal = document_ordinals_.find(document_id); ordinal != document_ordinals_.end()){
+            for (const auto [term, term_freq] : document_terms_[ordinal->second]) {
+                word_freqs.emplace(terms_.GetText(term), term_freq);
+            }
         }
-        
-        static std::map<string_view, double> zero;
-        return zero;
+        return word_freqs;
     }
  
     void SearchServer::RemoveDocument(int document_id){
-        for (auto [word, tf] : word_freqs_by_id_.at(document_id)){
-            word_to_document_freqs_.at(word).erase(document_id);
-        }
-        word_freqs_by_id_.erase(document_id);
-        documents_.erase(document_id);
-        document_ids_.erase(document_id);
+        RemoveDocument(std::execution::seq, document_id);
     }
  
     void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int document_id){
-        for (auto [word, tf] : word_freqs_by_id_.at(document_id)){
-            word_to_document_freqs_.at(word).erase(document_id);
+        PROFILE_DURATION("index.remove_document"s);
+        const uint32_t ordinal = document_ordinals_.at(document_id);
+        // из неизменяемого сегмента документ уходит при слиянии, до тех пор он отмечен удалённым
+        if (documents_[ordinal].is_mutable) {
+            for (const auto [term, term_freq] : document_terms_[ordinal]){
+                term_data_[term].postings.Remove(document_id);
+            }
+        } else {
+            segments_->Kill(ordinal);
         }
-        word_freqs_by_id_.erase(document_id);
-        documents_.erase(document_id);
-        document_ids_.erase(document_id);
+        EraseDocument(document_id);
     }
 
     void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id){
-        
-    std::vector<string_view> result(word_freqs_by_id_.at(document_id).size());
-    std::transform(std::execution::par_unseq,
-  word_freqs_by_id_.at(document_id).begin(),word_freqs_by_id_.at(document_id).end(), result.begin(),
-        [](const auto& data) { return data.first; }
-    );
- 
-    std::for_each(std::execution::par_unseq,
-        result.begin(),result.end(),
-        [this,document_id](const auto word) {
-            word_to_document_freqs_.at(word).erase(document_id);
+        PROFILE_DURATION("index.remove_document"s);
+        const uint32_t ordinal = document_ordinals_.at(document_id);
+        if (documents_[ordinal].is_mutable) {
+            const auto& document_terms = document_terms_[ordinal];
+            // каждый поток меняет свой список вхождений
+            std::for_each(std::execution::par,
+                document_terms.begin(), document_terms.end(),
+                [this,document_id](const TermFrequency& term_frequency) {
+                    term_data_[term_frequency.term].postings.Remove(document_id);
+                }
+            );
+        } else {
+            segments_->Kill(ordinal);
         }
-    );
-    word_freqs_by_id_.erase(document_id);
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
+        EraseDocument(document_id);
+    }
+
+    void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+        RemoveDocumentsBatch(std::execution::seq, document_ids);
+    }
+
+    void SearchServer::RemoveDocuments(const std::execution::sequenced_policy&, const vector<int>& document_ids) {
+        RemoveDocumentsBatch(std::execution::seq, document_ids);
+    }
+
+    void SearchServer::RemoveDocuments(const std::execution::parallel_policy&, const vector<int>& document_ids) {
+        RemoveDocumentsBatch(std::execution::par, document_ids);
+    }
+
+    template <typename ExecutionPolicy>
+    void SearchServer::RemoveDocumentsBatch(const ExecutionPolicy& policy, const vector<int>& document_ids) {
+        PROFILE_DURATION("index.remove_documents"s);
+        vector<int> ids = document_ids;
+        sort(policy, ids.begin(), ids.end());
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+        for (const int document_id : ids) {
+            if (document_ordinals_.count(document_id) == 0) {
+                throw out_of_range("Invalid document_id"s);
+            }
+        }
+
+        // Документы неизменяемых сегментов сразу отмечаются удалёнными, а вхождения изменяемого
+        // собираются по словам, чтобы каждый затронутый список вычистить за один проход
+        vector<pair<TermId, int>> removed_postings;
+        vector<uint32_t> dead_ordinals;
+        for (const int document_id : ids) {
+            const uint32_t ordinal = document_ordinals_.at(document_id);
+            if (documents_[ordinal].is_mutable) {
+                for (const auto [term, term_freq] : document_terms_[ordinal]) {
+                    removed_postings.push_back({term, document_id});
+                }
+            } else {
+                dead_ordinals.push_back(ordinal);
+            }
+        }
+        sort(policy, removed_postings.begin(), removed_postings.end());
+        vector<pair<size_t, size_t>> term_ranges;
+        for (size_t first = 0, last = 0; first < removed_postings.size(); first = last) {
+            last = first + 1;
+            while (last < removed_postings.size() && removed_postings[last].first == removed_postings[first].first) {
+                ++last;
+            }
+            term_ranges.push_back({first, last});
+        }
+        // каждый поток меняет свои списки вхождений
+        for_each(policy, term_ranges.begin(), term_ranges.end(), [&](const pair<size_t, size_t>& range) {
+            vector<int> term_document_ids;
+            term_document_ids.reserve(range.second - range.first);
+            for (size_t i = range.first; i < range.second; ++i) {
+                term_document_ids.push_back(removed_postings[i].second);
+            }
+            term_data_[removed_postings[range.first].first].postings.RemoveSorted(term_document_ids);
+        });
+        if (!dead_ordinals.empty()) {
+            segments_->Kill(dead_ordinals);
+        }
+        for (const int document_id : ids) {
+            EraseDocument(document_id);
+        }
+    }
+
+    void SearchServer::EraseDocument(int document_id) {
+        const uint32_t ordinal = document_ordinals_.at(document_id);
+        for (const auto [term, term_freq] : document_terms_[ordinal]) {
+            terms_.Release(term);
+            // слово больше не встречается ни в одном документе
+            if (--term_data_[term].document_count == 0) {
+                term_data_[term] = TermData();
+            }
+        }
+        vector<TermFrequency>().swap(document_terms_[ordinal]);
+        status_index_.Erase(ordinal, documents_[ordinal].status);
+        // номер документа из неизменяемого сегмента освободится после слияния
+        if (documents_[ordinal].is_mutable) {
+            documents_[ordinal].is_mutable = false;
+            free_ordinals_.push_back(ordinal);
+        }
+        document_ordinals_.erase(document_id);
+        document_ids_.erase(document_id);
+        ++index_version_;
+    }
+
+    void SearchServer::Compact() {
+        FlushMutableSegment();
+        vector<uint32_t>().swap(mutable_ordinals_);
+        // живые документы получают номера подряд, чтобы в массивах документов не осталось дыр
+        vector<uint32_t> new_ordinals(documents_.size(), 0);
+        uint32_t document_count = 0;
+        for (uint32_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+            const auto it = document_ordinals_.find(documents_[ordinal].id);
+            if (it != document_ordinals_.end() && it->second == ordinal) {
+                new_ordinals[ordinal] = document_count++;
+            }
+        }
+        segments_->MergeAll(new_ordinals);
+        for (uint32_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+            const auto it = document_ordinals_.find(documents_[ordinal].id);
+            if (it != document_ordinals_.end() && it->second == ordinal && new_ordinals[ordinal] != ordinal) {
+                it->second = new_ordinals[ordinal];
+                documents_[new_ordinals[ordinal]] = documents_[ordinal];
+                document_terms_[new_ordinals[ordinal]] = move(document_terms_[ordinal]);
+            }
+        }
+        documents_.resize(document_count);
+        document_terms_.resize(document_count);
+        status_index_.Clear();
+        for (uint32_t ordinal = 0; ordinal < document_count; ++ordinal) {
+            status_index_.Insert(ordinal, documents_[ordinal].status);
+        }
+        vector<uint32_t>().swap(free_ordinals_);
+        documents_.shrink_to_fit();
+        document_terms_.shrink_to_fit();
+        term_data_.resize(terms_.IdBound());
+        term_data_.shrink_to_fit();
+    }
+
+    MemoryUsage SearchServer::GetMemoryUsage() const {
+        // узлы деревьев и хеш-таблиц: данные плюс служебные указатели
+        constexpr size_t TREE_NODE_OVERHEAD = 4 * sizeof(void*);
+        constexpr size_t HASH_NODE_OVERHEAD = 2 * sizeof(void*);
+
+        MemoryUsage usage;
+        usage.term_count = terms_.size();
+        usage.term_bytes = terms_.GetMemoryUsage();
+        usage.posting_bytes = term_data_.capacity() * sizeof(TermData) + mutable_ordinals_.capacity() * sizeof(uint32_t)
+            + segments_->GetMemoryUsage();
+        for (const auto& [postings, document_count, inverse_document_freq] : term_data_) {
+            usage.posting_count += document_count;
+            usage.posting_bytes += postings.GetMemoryUsage();
+        }
+        usage.document_bytes = documents_.capacity() * sizeof(DocumentData)
+            + free_ordinals_.capacity() * sizeof(uint32_t) + status_index_.GetMemoryUsage()
+            + document_ordinals_.bucket_count() * sizeof(void*)
+            + document_ordinals_.size() * (sizeof(pair<const int, uint32_t>) + HASH_NODE_OVERHEAD)
+            + document_ids_.size() * (sizeof(int) + TREE_NODE_OVERHEAD);
+        usage.document_bytes += document_terms_.capacity() * sizeof(vector<TermFrequency>);
+        for (const auto& document_terms : document_terms_) {
+            usage.document_bytes += document_terms.capacity() * sizeof(TermFrequency);
+        }
+        return usage;
+    }
+
+    namespace {
+    // "SRCHSNAP" в порядке байтов little-endian
+    const uint64_t SNAPSHOT_MAGIC = 0x50414e5348435253;
+    const uint32_t SNAPSHOT_VERSION = 5;
+    // по нему читатель узнаёт снимок, записанный с другим порядком байтов
+    const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+    // Документ в снимке: без признака изменяемого сегмента и без выравнивания, так что
+    // одинаковый индекс всегда записывается одинаковыми байтами
+    struct SnapshotDocument {
+        int32_t id;
+        int32_t rating;
+        int32_t status;
+    };
+    }
+
+    // Формат снимка: заголовок, стоп-слова, документы с рейтингом и статусом, слова документов,
+    // словарь, число документов с каждым словом и живые вхождения всех сегментов одним сжатым
+    // сегментом. Массивы лежат в файле в том же представлении, что и в памяти, поэтому при загрузке
+    // вхождения не разбираются и не копируются.
+    void SearchServer::SaveSnapshot(const string& path) const {
+        SnapshotWriter writer(path);
+        writer.Write(SNAPSHOT_MAGIC);
+        writer.Write(SNAPSHOT_VERSION);
+        writer.Write(SNAPSHOT_BYTE_ORDER);
+        writer.Write<uint32_t>(sizeof(PostingBlock));
+        writer.Write<uint32_t>(sizeof(SnapshotDocument));
+        writer.Write<uint32_t>(sizeof(TermFrequency));
+
+        writer.Write<uint64_t>(stop_words_.size());
+        for (const string& stop_word : stop_words_) {
+            writer.WriteString(stop_word);
+        }
+        writer.Write<uint64_t>(max_result_document_count_);
+
+        vector<SnapshotDocument> documents;
+        documents.reserve(documents_.size());
+        for (const DocumentData& document_data : documents_) {
+            documents.push_back({document_data.id, document_data.rating, static_cast<int32_t>(document_data.status)});
+        }
+        writer.WriteArray(documents);
+        // номера удалённых документов, ещё не освобождённые слиянием, тоже свободны
+        vector<uint32_t> free_ordinals;
+        for (uint32_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+            const auto it = document_ordinals_.find(documents_[ordinal].id);
+            if (it == document_ordinals_.end() || it->second != ordinal) {
+                free_ordinals.push_back(ordinal);
+            }
+        }
+        writer.WriteArray(free_ordinals);
+        // слова документов одним массивом со смещениями начала каждого документа
+        vector<uint64_t> offsets(document_terms_.size() + 1, 0);
+        for (size_t ordinal = 0; ordinal < document_terms_.size(); ++ordinal) {
+            offsets[ordinal + 1] = offsets[ordinal] + document_terms_[ordinal].size();
+        }
+        writer.WriteArray(offsets);
+        writer.BeginArray<TermFrequency>(offsets.back());
+        for (const auto& document_terms : document_terms_) {
+            writer.WriteValues(document_terms.data(), document_terms.size());
+        }
+
+        writer.Write<uint64_t>(terms_.IdBound());
+        for (TermId term = 0; term < terms_.IdBound(); ++term) {
+            writer.Write<uint64_t>(terms_.GetReferences(term));
+            writer.WriteString(terms_.GetText(term));
+        }
+
+        vector<uint64_t> document_counts(terms_.IdBound(), 0);
+        for (TermId term = 0; term < terms_.IdBound(); ++term) {
+            document_counts[term] = term_data_[term].document_count;
+        }
+        writer.WriteArray(document_counts);
+        const auto segments = segments_->GetSegments();
+        SegmentBuilder builder;
+        vector<pair<uint32_t, double>> postings;
+        for (TermId term = 0; term < terms_.IdBound(); ++term) {
+            if (document_counts[term] == 0) {
+                continue;
+            }
+            postings.clear();
+            term_data_[term].postings.ForEach([&postings](const Posting& posting) {
+                postings.push_back({posting.ordinal, posting.term_freq});
+            });
+            for (const auto& segment : *segments) {
+                segment->ForEach(term, 0, numeric_limits<uint32_t>::max(), [&](uint32_t ordinal, double term_freq) {
+                    if (!segments_->IsDead(ordinal)) {
+                        postings.push_back({ordinal, term_freq});
+                    }
+                });
+            }
+            sort(postings.begin(), postings.end());
+            for (const auto& [ordinal, term_freq] : postings) {
+                builder.Add(term, ordinal, term_freq);
+            }
+        }
+        vector<uint32_t> ordinals;
+        for (uint32_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+            if (!binary_search(free_ordinals.begin(), free_ordinals.end(), ordinal)) {
+                ordinals.push_back(ordinal);
+            }
+        }
+        builder.Build(move(ordinals))->Save(writer);
+        writer.Finish();
+    }
+
+    SearchServer SearchServer::LoadSnapshot(const string& path) {
+        auto file = make_shared<const MappedFile>(path);
+        SnapshotReader reader(*file);
+        if (reader.Read<uint64_t>() != SNAPSHOT_MAGIC
+            || reader.Read<uint32_t>() != SNAPSHOT_VERSION
+            || reader.Read<uint32_t>() != SNAPSHOT_BYTE_ORDER
+            || reader.Read<uint32_t>() != sizeof(PostingBlock)
+            || reader.Read<uint32_t>() != sizeof(SnapshotDocument)
+            || reader.Read<uint32_t>() != sizeof(TermFrequency)) {
+            throw runtime_error(path + " is not a search server snapshot"s);
+        }
+
+        vector<string_view> stop_words(reader.Read<uint64_t>());
+        for (string_view& stop_word : stop_words) {
+            stop_word = reader.ReadString();
+        }
+        SearchServer search_server(stop_words);
+        search_server.max_result_document_count_ = reader.Read<uint64_t>();
+
+        size_t document_count = 0;
+        const SnapshotDocument* documents = reader.ReadArray<SnapshotDocument>(document_count);
+        search_server.documents_.reserve(document_count);
+        for (size_t ordinal = 0; ordinal < document_count; ++ordinal) {
+            const SnapshotDocument& document = documents[ordinal];
+            search_server.documents_.push_back(
+                {document.id, document.rating, static_cast<DocumentStatus>(document.status), false});
+        }
+        size_t free_ordinal_count = 0;
+        const uint32_t* free_ordinals = reader.ReadArray<uint32_t>(free_ordinal_count);
+        search_server.free_ordinals_.assign(free_ordinals, free_ordinals + free_ordinal_count);
+        size_t offset_count = 0;
+        const uint64_t* offsets = reader.ReadArray<uint64_t>(offset_count);
+        size_t document_term_count = 0;
+        const TermFrequency* document_terms = reader.ReadArray<TermFrequency>(document_term_count);
+        if (offset_count != document_count + 1 || offsets[document_count] != document_term_count) {
+            throw runtime_error(path + " is corrupted"s);
+        }
+
+        vector<bool> is_free(document_count, false);
+        for (const uint32_t ordinal : search_server.free_ordinals_) {
+            if (ordinal >= document_count) {
+                throw runtime_error(path + " is corrupted"s);
+            }
+            is_free[ordinal] = true;
+        }
+        search_server.document_terms_.resize(document_count);
+        search_server.document_ordinals_.reserve(document_count - free_ordinal_count);
+        vector<int> document_ids;
+        document_ids.reserve(document_count - free_ordinal_count);
+        for (uint32_t ordinal = 0; ordinal < document_count; ++ordinal) {
+            if (is_free[ordinal]) {
+                continue;
+            }
+            if (offsets[ordinal] > offsets[ordinal + 1] || offsets[ordinal + 1] > document_term_count
+                || static_cast<size_t>(documents[ordinal].status) >= DOCUMENT_STATUS_COUNT) {
+                throw runtime_error(path + " is corrupted"s);
+            }
+            search_server.document_terms_[ordinal].assign(document_terms + offsets[ordinal],
+                                                          document_terms + offsets[ordinal + 1]);
+            search_server.document_ordinals_.emplace(documents[ordinal].id, ordinal);
+            search_server.status_index_.Insert(ordinal, search_server.documents_[ordinal].status);
+            document_ids.push_back(documents[ordinal].id);
+        }
+        sort(document_ids.begin(), document_ids.end());
+        search_server.document_ids_.insert(document_ids.begin(), document_ids.end());
+
+        vector<pair<string_view, size_t>> terms(reader.Read<uint64_t>());
+        for (auto& [text, references] : terms) {
+            references = reader.Read<uint64_t>();
+            text = reader.ReadString();
+        }
+        search_server.terms_.Assign(terms);
+        search_server.term_data_.resize(terms.size());
+
+        size_t document_count_count = 0;
+        const uint64_t* document_counts = reader.ReadArray<uint64_t>(document_count_count);
+        if (document_count_count != terms.size()) {
+            throw runtime_error(path + " is corrupted"s);
+        }
+        for (TermId term = 0; term < terms.size(); ++term) {
+            search_server.term_data_[term].document_count = document_counts[term];
+        }
+        vector<uint32_t> ordinals;
+        ordinals.reserve(search_server.document_ordinals_.size());
+        for (uint32_t ordinal = 0; ordinal < document_count; ++ordinal) {
+            if (!is_free[ordinal]) {
+                ordinals.push_back(ordinal);
+            }
+        }
+        shared_ptr<const Segment> segment;
+        try {
+            segment = Segment::Load(reader, move(ordinals), move(file));
+        } catch (const runtime_error&) {
+            throw runtime_error(path + " is corrupted"s);
+        }
+        if (!reader.AtEnd()) {
+            throw runtime_error(path + " is corrupted"s);
+        }
+        if (!segment->GetOrdinals().empty()) {
+            search_server.segments_->AddSegment(move(segment));
+        }
+        return search_server;
     }
 
     bool SearchServer::IsStopWord(string_view word) const {
@@ -152,24 +712,144 @@ void SearchServer::AddDocument(int document_id, std::string_view document, Docum
             });
         }
 
-    vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
-        vector<string_view> words;
-        for (string_view word : SplitIntoWords(text)) {
-            if (!IsValidWord(word)) {
-                throw invalid_argument("Word "s + std::string(word) + " is invalid"s);
-            }
-            if (!IsStopWord(word)) {
-                words.push_back(word);
+    void SearchServer::SplitIntoWordsNoStop(string_view text, vector<string_view>& words) const {
+        if (!SplitIntoWords(text, words)) {
+            for (string_view word : words) {
+                if (!IsValidWord(word)) {
+                    throw invalid_argument("Word "s + std::string(word) + " is invalid"s);
+                }
             }
         }
-        return words;
+        if (!stop_words_.empty()) {
+            words.erase(remove_if(words.begin(), words.end(), [this](string_view word) { return IsStopWord(word); }),
+                        words.end());
+        }
+    }
+    map<string_view, double> SearchServer::ComputeWordFrequencies(string_view document) const {
+        vector<string_view>& words = GetThreadWords();
+        SplitIntoWordsNoStop(document, words);
+        const double inv_word_count = 1.0 / words.size();
+        map<string_view, double> word_freqs;
+        for (string_view word : words) {
+            word_freqs[word] += inv_word_count;
+        }
+        return word_freqs;
     }
+
     int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
         int rating_sum = std::accumulate(ratings.begin(), ratings.end(), 0);
         return rating_sum / static_cast<int>(ratings.size());
     }
 
-    SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
+    void SearchServer::CollectExcludedDocuments(const Query& query, const SegmentedIndex::SegmentList& segments,
+                                                OrdinalSet& excluded) const {
+        PROFILE_DURATION("search.minus_words"s);
+        excluded.Reset(documents_.size());
+        for (TermId term : query.minus_words) {
+            term_data_[term].postings.ForEach([&excluded](const Posting& posting) {
+                excluded.Insert(posting.ordinal);
+            });
+            // удалённые документы остаются в неизменяемых сегментах до слияния
+            for (const auto& segment : segments) {
+                segment->ForEach(term, 0, numeric_limits<uint32_t>::max(), [&](uint32_t ordinal, double) {
+                    if (!segments_->IsDead(ordinal)) {
+                        excluded.Insert(ordinal);
+                    }
+                });
+            }
+        }
+    }
+
+    RelevanceAccumulator& SearchServer::GetThreadAccumulator() {
+        static thread_local RelevanceAccumulator accumulator;
+        return accumulator;
+    }
+
+    OrdinalSet& SearchServer::GetThreadExcluded() {
+        static thread_local OrdinalSet excluded;
+        return excluded;
+    }
+
+    vector<string_view>& SearchServer::GetThreadWords() {
+        static thread_local vector<string_view> words;
+        return words;
+    }
+
+    SearchServer::MaxScoreBuffers& SearchServer::GetThreadMaxScoreBuffers() {
+        static thread_local MaxScoreBuffers buffers;
+        return buffers;
+    }
+
+    QueryContext& SearchServer::GetThreadContext() {
+        static thread_local QueryContext context;
+        return context;
+    }
+
+    const SearchServer::DocumentData& SearchServer::GetDocumentData(int document_id) const {
+        return documents_[document_ordinals_.at(document_id)];
+    }
+
+    uint32_t SearchServer::AllocateOrdinal(const DocumentData& document_data) {
+        if (free_ordinals_.empty()) {
+            ReclaimOrdinals();
+        }
+        uint32_t ordinal;
+        if (free_ordinals_.empty()) {
+            ordinal = documents_.size();
+            documents_.push_back(document_data);
+            document_terms_.emplace_back();
+        } else {
+            ordinal = free_ordinals_.back();
+            free_ordinals_.pop_back();
+            documents_[ordinal] = document_data;
+        }
+        status_index_.Insert(ordinal, document_data.status);
+        return ordinal;
+    }
+
+    void SearchServer::ReclaimOrdinals() {
+        const vector<uint32_t> ordinals = segments_->TakeReleasedOrdinals();
+        free_ordinals_.insert(free_ordinals_.end(), ordinals.begin(), ordinals.end());
+    }
+
+    void SearchServer::FlushMutableSegment() {
+        vector<uint32_t> ordinals;
+        ordinals.reserve(mutable_ordinals_.size());
+        for (const uint32_t ordinal : mutable_ordinals_) {
+            // удалённые документы уже убраны из списков вхождений и освободили номера
+            if (documents_[ordinal].is_mutable) {
+                documents_[ordinal].is_mutable = false;
+                ordinals.push_back(ordinal);
+            }
+        }
+        mutable_ordinals_.clear();
+        if (ordinals.empty()) {
+            return;
+        }
+        sort(ordinals.begin(), ordinals.end());
+
+        SegmentBuilder builder;
+        vector<Posting> postings;
+        for (TermId term = 0; term < term_data_.size(); ++term) {
+            PostingList& term_postings = term_data_[term].postings;
+            if (term_postings.empty()) {
+                continue;
+            }
+            postings.clear();
+            term_postings.ForEach([&postings](const Posting& posting) {
+                postings.push_back(posting);
+            });
+            term_postings = PostingList();
+            sort(postings.begin(), postings.end(),
+                 [](const Posting& lhs, const Posting& rhs) { return lhs.ordinal < rhs.ordinal; });
+            for (const Posting& posting : postings) {
+                builder.Add(term, posting.ordinal, posting.term_freq);
+            }
+        }
+        segments_->AddSegment(builder.Build(move(ordinals)));
+    }
+
+    SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text, bool check_symbols) const {
         if (text.empty()) {
             throw invalid_argument("Query word is empty"s);
         }
@@ -179,45 +859,188 @@ void SearchServer::AddDocument(int document_id, std::string_view document, Docum
             is_minus = true;
             text = text.substr(1);
         }
-        if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
+        if (text.empty() || text[0] == '-' || (check_symbols && !IsValidWord(text))) {
             throw invalid_argument("Query word "s + std::string(text) + " is invalid");
         }
         return {text, is_minus, IsStopWord(text)};
     }
 
-   SearchServer::Query SearchServer::ParseQuery(const bool execute_policy, string_view text) const {
-        Query result;
-        for (const string_view word : SplitIntoWords(text)) {
-            const auto query_word = ParseQueryWord(word);
-            if (!query_word.is_stop) {
+    ParsedQuery SearchServer::ParseQuery(string_view raw_query) const {
+        ParsedQuery result;
+        ParseQuery(raw_query, GetThreadWords(), result);
+        return result;
+    }
+
+    void SearchServer::ParseQuery(string_view text, vector<string_view>& words, Query& query) const {
+        PROFILE_DURATION("search.parse"s);
+        query.plus_words.clear();
+        query.minus_words.clear();
+        const bool check_symbols = !SplitIntoWords(text, words);
+        for (const string_view word : words) {
+            const auto query_word = ParseQueryWord(word, check_symbols);
+            const TermId term = terms_.Find(query_word.data);
+            if (!query_word.is_stop && term != TermDictionary::NO_TERM) {
                 if (query_word.is_minus) {
-                    result.minus_words.push_back(query_word.data);
+                    query.minus_words.push_back(term);
                 } else {
-                    result.plus_words.push_back(query_word.data);
+                    query.plus_words.push_back(term);
                 }
             }
         }
-        if (!execute_policy) {
-            VectorEraseDuplicate(std::execution::seq, result.minus_words);
-            VectorEraseDuplicate(std::execution::seq, result.plus_words);
+        VectorEraseDuplicate(std::execution::seq, query.minus_words);
+        VectorEraseDuplicate(std::execution::seq, query.plus_words);
+    }
+
+    double SearchServer::ComputeWordInverseDocumentFreq(const TermData& term_data) const {
+        return term_data.inverse_document_freq.Get(index_version_, [&] {
+            return log(GetDocumentCount() * 1.0 / term_data.document_count);
+        });
+    }
+
+    SearchServer::CompiledFilter SearchServer::CompileStatusFilter(DocumentStatus status) {
+        return {static_cast<uint8_t>(1 << static_cast<int>(status)), numeric_limits<int>::min(),
+                numeric_limits<int>::max(), nullptr};
+    }
+
+    SearchServer::CompiledFilter SearchServer::CompileFilter(const DocumentFilter& filter, QueryContext& context) const {
+        CompiledFilter compiled_filter{0, filter.min_rating, filter.max_rating, nullptr};
+        for (const DocumentStatus status : filter.statuses) {
+            compiled_filter.status_mask |= 1 << static_cast<int>(status);
         }
-        
-        return result;
+        if (filter.document_ids) {
+            context.allowed_.Reset(documents_.size());
+            context.candidates_.clear();
+            for (const int document_id : *filter.document_ids) {
+                const auto it = document_ordinals_.find(document_id);
+                if (it != document_ordinals_.end() && !context.allowed_.Contains(it->second)
+                    && AcceptDocument(compiled_filter, it->second)) {
+                    context.allowed_.Insert(it->second);
+                    context.candidates_.push_back(it->second);
+                }
+            }
+            sort(context.candidates_.begin(), context.candidates_.end());
+            compiled_filter.allowed_ordinals = &context.allowed_;
+        }
+        return compiled_filter;
     }
 
-    double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-        return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+    bool SearchServer::SelectCandidates(const CompiledFilter& filter, QueryContext& context) const {
+        // Кандидат проверяется по каждому слову запроса и стоит нескольких вхождений: его слова
+        // лежат отдельно, а вхождения читаются подряд и часть их отсекается без чтения.
+        // Рейтинг в оценку числа кандидатов не входит.
+        constexpr size_t CANDIDATE_COST = 4;
+        size_t posting_count = 0;
+        for (const TermId term : context.query_.plus_words) {
+            posting_count += term_data_[term].document_count;
+        }
+        const size_t term_count = context.query_.plus_words.size() * CANDIDATE_COST;
+        if (filter.allowed_ordinals != nullptr) {
+            return context.candidates_.size() * term_count < posting_count;
+        }
+        size_t candidate_count = 0;
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+            if (filter.status_mask >> status & 1) {
+                candidate_count += status_index_.GetDocumentCount(static_cast<DocumentStatus>(status));
+            }
+        }
+        if (candidate_count * term_count >= posting_count) {
+            return false;
+        }
+        context.candidates_.clear();
+        status_index_.ForEach(filter.status_mask, [&](uint32_t ordinal) {
+            const int rating = documents_[ordinal].rating;
+            if (rating >= filter.min_rating && rating <= filter.max_rating) {
+                context.candidates_.push_back(ordinal);
+            }
+        });
+        return true;
     }
 
-    void SearchServer::VectorEraseDuplicate(const std::execution::sequenced_policy, std::vector<std::string_view>& vec) const {
-        std::sort(vec.begin(), vec.end());
-        auto last = std::unique(vec.begin(), vec.end());
-        vec.erase(last, vec.end());
+    void SearchServer::FindCandidateDocuments(QueryContext& context) const {
+        PROFILE_DURATION("search.candidates"s);
+        const Query& query = context.query_;
+        context.top_documents_.Reset(max_result_document_count_);
+        const auto term_less = [](const TermFrequency& lhs, TermId term) { return lhs.term < term; };
+        for (const uint32_t ordinal : context.candidates_) {
+            const auto& document_terms = document_terms_[ordinal];
+            // слова запроса и документа отсортированы, так что поиск идёт только вперёд
+            auto minus_it = document_terms.begin();
+            bool is_excluded = false;
+            for (const TermId term : query.minus_words) {
+                minus_it = lower_bound(minus_it, document_terms.end(), term, term_less);
+                if (minus_it != document_terms.end() && minus_it->term == term) {
+                    is_excluded = true;
+                    break;
+                }
+            }
+            if (is_excluded) {
+                continue;
+            }
+            // релевантность складывается в порядке слов запроса, как и при обходе вхождений
+            double relevance = 0.0;
+            bool is_matched = false;
+            auto it = document_terms.begin();
+            for (const TermId term : query.plus_words) {
+                it = lower_bound(it, document_terms.end(), term, term_less);
+                if (it == document_terms.end()) {
+                    break;
+                }
+                if (it->term == term) {
+                    relevance += it->term_freq * ComputeWordInverseDocumentFreq(term_data_[term]);
+                    is_matched = true;
+                }
+            }
+            if (is_matched) {
+                const auto& document_data = documents_[ordinal];
+                context.top_documents_.Push({document_data.id, relevance, document_data.rating});
+            }
+        }
+        PROFILE_DURATION("search.sort"s);
+        context.top_documents_.ExtractTo(context.result_);
+    }
+
+    void SearchServer::FindFilteredDocuments(QueryContext& context, const CompiledFilter& filter) const {
+        if (SelectCandidates(filter, context)) {
+            FindCandidateDocuments(context);
+        } else {
+            FindAllDocuments(context, filter);
+        }
+    }
+
+    void SearchServer::MatchTerms(const Query& query, uint32_t ordinal, vector<string_view>& words) const {
+        words.clear();
+        const auto& document_terms = document_terms_[ordinal];
+        const auto term_less = [](const TermFrequency& lhs, TermId term) { return lhs.term < term; };
+        // Слова запроса и документа отсортированы, так что документ просматривается только
+        // вперёд: от прошлой находки шагами 1, 2, 4, ..., затем двоичный поиск в последнем шаге.
+        // Для запроса из k слов это O(k log(m / k)) вместо O(k log m) на m слов документа.
+        const auto find_term = [&](auto& it, TermId term) {
+            auto last = it;
+            for (ptrdiff_t step = 1; last != document_terms.end() && last->term < term; step *= 2) {
+                it = last + 1;
+                last = step < document_terms.end() - it ? it + step : document_terms.end();
+            }
+            it = lower_bound(it, last, term, term_less);
+            return it != document_terms.end() && it->term == term;
+        };
+        auto it = document_terms.begin();
+        for (const TermId term : query.minus_words) {
+            if (find_term(it, term)) {
+                return;
+            }
+        }
+        it = document_terms.begin();
+        for (const TermId term : query.plus_words) {
+            if (find_term(it, term)) {
+                words.push_back(terms_.GetText(term));
+            }
+        }
+        sort(words.begin(), words.end());
     }
 
-    void SearchServer::VectorEraseDuplicate(const std::execution::parallel_policy, std::vector<std::string_view>& vec) const {
-        std::sort(std::execution::par,vec.begin(), vec.end());
-        auto last = std::unique(std::execution::par, vec.begin(), vec.end());
+    void SearchServer::VectorEraseDuplicate(const std::execution::sequenced_policy, std::vector<TermId>& vec) const {
+        std::sort(vec.begin(), vec.end());
+        auto last = std::unique(vec.begin(), vec.end());
         vec.erase(last, vec.end());
     }
 
@@ -1,7 +1,19 @@
 #pragma once
 #include "string_processing.h"
 #include "document.h"
-#include "concurrent_map.h"
+#include "document_filter.h"
+#include "posting_list.h"
+#include "top_documents.h"
+#include "relevance_accumulator.h"
+#include "ordinal_set.h"
+#include "status_index.h"
+#include "term_dictionary.h"
+#include "versioned_value.h"
+#include "snapshot.h"
+#include "segmented_index.h"
+#include "query_context.h"
+#include "query_cache.h"
+#include "log_duration.h"
 
 #include <execution>
 #include <vector>
@@ -11,11 +23,39 @@
 #include <cmath>
 #include <stdexcept>
 #include <string>
-#include <deque>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 using namespace std;
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double PRESICION_RELEVANCE = 1e-6;
+
+const size_t SEGMENT_DOCUMENT_COUNT = 16384;
+
+// Документ для пакетного добавления через SearchServer::AddDocuments
+struct NewDocument {
+    int id;
+    std::string_view text;
+    DocumentStatus status;
+    vector<int> ratings;
+};
+
+// Оценка памяти, занятой индексом, в байтах
+struct MemoryUsage {
+    size_t term_count = 0;
+    size_t term_bytes = 0;
+    size_t posting_count = 0;
+    size_t posting_bytes = 0;
+    size_t document_bytes = 0;
+
+    size_t Total() const {
+        return term_bytes + posting_bytes + document_bytes;
+    }
+};
 
 class SearchServer {
 public:
@@ -28,10 +68,26 @@ public:
     explicit SearchServer(const string& stop_words_text);
     
     explicit SearchServer(string_view stop_words_text);
+
+    // Сервер только перемещается: кэш выдачи и неизменяемые сегменты с фоновым слиянием
+    // принадлежат одному серверу
+    SearchServer(const SearchServer&) = delete;
+    SearchServer& operator=(const SearchServer&) = delete;
+    SearchServer(SearchServer&&) = default;
+    SearchServer& operator=(SearchServer&&) = default;
  
     void AddDocument(int document_id, std::string_view document, DocumentStatus status,
                      const vector<int>& ratings);
     
+    // Добавляет пакет документов. Если хотя бы один id или слово некорректны,
+    // выбрасывает invalid_argument и не добавляет ни одного документа.
+    void AddDocuments(const vector<NewDocument>& documents);
+    
+    void AddDocuments(const std::execution::sequenced_policy&, const vector<NewDocument>& documents);
+    
+    // Разбирает документы и строит частичные индексы параллельно, затем вливает их в индекс
+    void AddDocuments(const std::execution::parallel_policy&, const vector<NewDocument>& documents);
+    
     template <typename DocumentPredicate>
     vector<Document> FindTopDocuments(string_view raw_query,
                                       DocumentPredicate document_predicate) const;
@@ -51,8 +107,60 @@ public:
     template <typename ExecutionPolicy> 
     vector<Document> FindTopDocuments(const ExecutionPolicy& policy, string_view raw_query) const; 
     
+    // Выдача та же, что с равносильным предикатом. Если под фильтр подходит мало документов,
+    // релевантность считается только для них, минуя списки вхождений.
+    vector<Document> FindTopDocuments(string_view raw_query, const DocumentFilter& filter) const;
+    
+    template <typename ExecutionPolicy>
+    vector<Document> FindTopDocuments(const ExecutionPolicy& policy, string_view raw_query,
+                                      const DocumentFilter& filter) const;
+    
+    // Варианты с буферами из context: повторный запрос с тем же контекстом не выделяет память.
+    // Результат лежит в контексте и действителен до следующего запроса с ним.
+    template <typename DocumentPredicate>
+    const vector<Document>& FindTopDocuments(QueryContext& context, string_view raw_query,
+                                             DocumentPredicate document_predicate) const;
+    
+    const vector<Document>& FindTopDocuments(QueryContext& context, string_view raw_query,
+                                             DocumentStatus status) const;
+    
+    const vector<Document>& FindTopDocuments(QueryContext& context, string_view raw_query) const;
+    
+    const vector<Document>& FindTopDocuments(QueryContext& context, string_view raw_query,
+                                             const DocumentFilter& filter) const;
+    
+    // Поиск по запросу, уже разобранному ParseQuery
+    const vector<Document>& FindTopDocuments(QueryContext& context, const ParsedQuery& query,
+                                             DocumentStatus status = DocumentStatus::ACTUAL) const;
+    
+    // Разбирает запрос в id слов. Разобранный запрос действителен, пока слова не ушли из индекса.
+    // Выбрасывает invalid_argument, если запрос некорректен.
+    ParsedQuery ParseQuery(string_view raw_query) const;
+    
     int GetDocumentCount() const;
     
+    // Сколько документов возвращает FindTopDocuments, по умолчанию MAX_RESULT_DOCUMENT_COUNT
+    void SetMaxResultDocumentCount(size_t count);
+    
+    size_t GetMaxResultDocumentCount() const;
+    
+    // Включает кэш результатов поиска по статусу документа на capacity запросов, 0 - выключает.
+    // Кэш сбрасывается при каждом добавлении и удалении документов; запросы с предикатом
+    // идут мимо кэша.
+    void SetQueryCacheCapacity(size_t capacity);
+    
+    QueryCacheStats GetQueryCacheStats() const;
+    
+    // Сколько документов набирается в изменяемом сегменте, прежде чем он станет неизменяемым,
+    // по умолчанию SEGMENT_DOCUMENT_COUNT. Пакеты AddDocuments такого размера и больше
+    // сразу становятся отдельным сегментом.
+    void SetSegmentDocumentCount(size_t count);
+    
+    // Включает (по умолчанию) или выключает отсечение в неизменяемых сегментах: документы,
+    // чья релевантность заведомо не дотягивает до худшего из уже отобранных, не досчитываются.
+    // Выдача от этого не меняется.
+    void SetDynamicPruning(bool enabled);
+    
     auto begin() const{
         return document_ids_.begin();
     }
@@ -61,6 +169,7 @@ public:
         return document_ids_.end();
     }
  
+   // Найденные слова указывают в словарь сервера и действительны, пока слово есть в индексе
    tuple<vector<string_view>, DocumentStatus> MatchDocument(string_view raw_query,
                                                         int document_id) const;
                                                                                 
@@ -69,35 +178,130 @@ public:
     
    tuple<vector<string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, string_view raw_query,
                                                         int document_id) const;
+   
+   // MatchDocument для каждого документа из document_ids (например, для страницы выдачи),
+   // запрос разбирается один раз. Если какого-то id нет, выбрасывает out_of_range.
+   vector<tuple<vector<string_view>, DocumentStatus>> MatchDocuments(string_view raw_query,
+                                                                     const vector<int>& document_ids) const;
     
-   const map<string_view, double>& GetWordFrequencies(int document_id) const;
+   map<string_view, double> GetWordFrequencies(int document_id) const;
+   
+   // Вызывает function(TermId term) для слов документа по возрастанию id. Id слов
+   // позволяют сравнивать наборы слов документов без копирования строк.
+   template <typename Function>
+   void ForEachDocumentTerm(int document_id, Function function) const;
 
    void RemoveDocument(int document_id);
  
    void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
    
    void RemoveDocument(const std::execution::parallel_policy&, int document_id);
+   
+   // Удаляет пакет документов: каждый затронутый список вхождений изменяемого сегмента
+   // вычищается один раз, а документы неизменяемых сегментов сразу исчезают из поиска и
+   // вычищаются фоновым слиянием. Если какого-то id нет, выбрасывает out_of_range и не
+   // удаляет ни одного документа. Повторы id допустимы.
+   void RemoveDocuments(const vector<int>& document_ids);
+   
+   void RemoveDocuments(const std::execution::sequenced_policy&, const vector<int>& document_ids);
+   
+   void RemoveDocuments(const std::execution::parallel_policy&, const vector<int>& document_ids);
+   
+   // Сливает все сегменты индекса в один, выбрасывая вхождения удалённых документов,
+   // и освобождает лишнюю память
+   void Compact();
+   
+   MemoryUsage GetMemoryUsage() const;
+   
+   // Сохраняет стоп-слова, документы, словарь и списки вхождений в двоичный снимок.
+   // Выбрасывает runtime_error при ошибке записи.
+   void SaveSnapshot(const string& path) const;
+   
+   // Загружает сервер из снимка SaveSnapshot. Файл отображается в память, и списки вхождений
+   // становятся неизменяемым сегментом прямо над ним. Выбрасывает runtime_error,
+   // если файл не читается или не является снимком текущей версии формата.
+   static SearchServer LoadSnapshot(const string& path);
     
 private:
     struct DocumentData {
+        int id;
         int rating;
         DocumentStatus status;
+        // вхождения документа лежат в изменяемом сегменте, а не в segments_
+        bool is_mutable;
+    };
+    
+    struct TermData {
+        // вхождения слова в изменяемом сегменте
+        PostingList postings;
+        // число документов со словом во всех сегментах
+        size_t document_count = 0;
+        // IDF слова для версии индекса index_version_, пересчитывается при первом обращении
+        VersionedValue inverse_document_freq;
+    };
+    
+    struct TermFrequency {
+        TermId term;
+        double term_freq;
     };
     
-    std::deque<std::string> storage_;
     const set<string, std::less<>> stop_words_;
-    map<string_view, map<int, double>> word_to_document_freqs_;
-    map<int, map<string_view, double>> word_freqs_by_id_;
-    map<int, DocumentData> documents_;
+    TermDictionary terms_;
+    // изменяемый сегмент и частоты по id слова
+    vector<TermData> term_data_;
+    // порядковые номера документов изменяемого сегмента, среди них бывают
+    // удалённые и повторяющиеся
+    vector<uint32_t> mutable_ordinals_;
+    size_t segment_document_count_ = SEGMENT_DOCUMENT_COUNT;
+    // неизменяемые сегменты; за адресом следит фоновый поток слияния
+    unique_ptr<SegmentedIndex> segments_ = make_unique<SegmentedIndex>();
+    // меняется при каждом изменении числа документов и частот слов
+    uint64_t index_version_ = 0;
+    // данные документов по порядковым номерам, номера удалённых документов переиспользуются
+    vector<DocumentData> documents_;
+    // слова документов по порядковым номерам, отсортированы по id слова
+    vector<vector<TermFrequency>> document_terms_;
+    vector<uint32_t> free_ordinals_;
+    // порядковые номера живых документов по статусам
+    StatusIndex status_index_;
+    unordered_map<int, uint32_t> document_ordinals_;
     set<int> document_ids_;
+    size_t max_result_document_count_ = MAX_RESULT_DOCUMENT_COUNT;
+    // выдача запросов по статусу для версии индекса index_version_, если кэш включён
+    unique_ptr<QueryCache> query_cache_;
+    bool dynamic_pruning_ = true;
     
     bool IsStopWord(string_view word) const;
     
     static bool IsValidWord(string_view word);
     
-    vector<string_view> SplitIntoWordsNoStop(string_view text) const;
+    // Записывает в words слова текста без стоп-слов
+    void SplitIntoWordsNoStop(string_view text, vector<string_view>& words) const;
+    
+    map<string_view, double> ComputeWordFrequencies(string_view document) const;
     
     static int ComputeAverageRating(const vector<int>& ratings);
+    
+    const DocumentData& GetDocumentData(int document_id) const;
+    
+    // Удаляет всё, кроме вхождений, относящееся к документу, чьи вхождения в изменяемом
+    // сегменте уже удалены, а в неизменяемом - отмечены удалёнными
+    void EraseDocument(int document_id);
+    
+    template <typename ExecutionPolicy>
+    void RemoveDocumentsBatch(const ExecutionPolicy& policy, const vector<int>& document_ids);
+   
+    // Вынимает порядковый номер для нового документа
+    uint32_t AllocateOrdinal(const DocumentData& document_data);
+    
+    // Забирает номера, освобождённые слиянием сегментов
+    void ReclaimOrdinals();
+    
+    // Превращает изменяемый сегмент в неизменяемый
+    void FlushMutableSegment();
+    
+    template <typename ExecutionPolicy>
+    void AddDocumentsBatch(const ExecutionPolicy& policy, const vector<NewDocument>& documents);
    
     struct QueryWord {
         string_view data;
@@ -105,33 +309,118 @@ private:
         bool is_stop;
     };
     
-    QueryWord ParseQueryWord(string_view text) const;
+    // Символы слова проверяются, только если check_symbols: обычно их уже проверил SplitIntoWords
+    QueryWord ParseQueryWord(string_view text, bool check_symbols) const;
+    
+    using Query = ParsedQuery;
+    
+    // Разбирает запрос в query, разбивая текст на слова в буфер words
+    void ParseQuery(string_view text, vector<string_view>& words, Query& query) const;
+    
+    void VectorEraseDuplicate(const std::execution::sequenced_policy, std::vector<TermId>& vec) const;
+    
+    double ComputeWordInverseDocumentFreq(const TermData& term_data) const;
+    
+    // Плюс-слова запроса, которые есть в документе, по алфавиту; пусто, если в документе
+    // есть минус-слово
+    void MatchTerms(const Query& query, uint32_t ordinal, vector<string_view>& words) const;
+ 
+    static RelevanceAccumulator& GetThreadAccumulator();
+    
+    static OrdinalSet& GetThreadExcluded();
+    
+    // Буфер слов для разбора документов и запросов, свой у каждого потока
+    static vector<string_view>& GetThreadWords();
+    
+    // Контекст для FindTopDocuments без явного контекста, свой у каждого потока
+    static QueryContext& GetThreadContext();
+    
+    struct MaxScoreTerm {
+        Segment::Cursor cursor;
+        double inverse_document_freq;
+        // оценки сверху вклада слова во всём отрезке и в текущем блоке
+        double max_score;
+        double block_max_score;
+    };
+    
+    struct MaxScoreBuffers {
+        // слова в порядке запроса, в нём же складывается релевантность
+        vector<MaxScoreTerm> terms;
+        // слова по возрастанию max_score и накопленные суммы max_score в этом порядке
+        vector<MaxScoreTerm*> order;
+        vector<double> max_score_sums;
+    };
+    
+    static MaxScoreBuffers& GetThreadMaxScoreBuffers();
     
-    struct Query {
-       vector<string_view> plus_words;
-       vector<string_view> minus_words;
+    // DocumentFilter, разобранный для проверки по порядковому номеру
+    struct CompiledFilter {
+        // бит 1 << status для каждого допустимого статуса
+        uint8_t status_mask;
+        int min_rating;
+        int max_rating;
+        // допустимые номера, если фильтр ограничивает id
+        const OrdinalSet* allowed_ordinals;
     };
     
-    Query ParseQuery(const bool flag, string_view text) const;
+    static CompiledFilter CompileStatusFilter(DocumentStatus status);
+    
+    // Список id фильтра раскладывается в context.allowed_ и context.candidates_
+    CompiledFilter CompileFilter(const DocumentFilter& filter, QueryContext& context) const;
+    
+    // Если документов, проходящих фильтр, меньше, чем вхождений слов запроса из context,
+    // выписывает их в context.candidates_ по возрастанию номеров и возвращает true
+    bool SelectCandidates(const CompiledFilter& filter, QueryContext& context) const;
+    
+    // Считает релевантность документов из context.candidates_ по их словам, минуя списки вхождений
+    void FindCandidateDocuments(QueryContext& context) const;
     
-    void VectorEraseDuplicate(const std::execution::sequenced_policy, std::vector<std::string_view>& vec) const;
-        
-    void VectorEraseDuplicate(const std::execution::parallel_policy, std::vector<std::string_view>& vec) const;
+    // Ищет по разобранному в context запросу документы, проходящие фильтр
+    void FindFilteredDocuments(QueryContext& context, const CompiledFilter& filter) const;
     
-    Query ParseQuery(string_view text) const;
+    template <typename ExecutionPolicy>
+    vector<Document> FindFilteredDocuments(const ExecutionPolicy& policy, QueryContext& context,
+                                           const CompiledFilter& filter) const;
     
-    double ComputeWordInverseDocumentFreq(string_view word) const;
+    template <typename DocumentPredicate>
+    bool AcceptDocument(DocumentPredicate& document_predicate, uint32_t ordinal) const;
+    
+    // Собирает в excluded порядковые номера живых документов всех сегментов, содержащих
+    // минус-слова запроса. Номера общие для сегментов, поэтому множество строится один раз
+    // на запрос и только читается при подсчёте релевантности.
+    void CollectExcludedDocuments(const Query& query, const SegmentedIndex::SegmentList& segments,
+                                  OrdinalSet& excluded) const;
+
+    // Считает релевантность документов сегмента из отрезка [first, last] и отбирает лучшие
+    // из них в matched_documents. Для изменяемого сегмента (nullptr) отрезок задаётся по id
+    // документов, для неизменяемого - по порядковым номерам. Документы из excluded пропускаются.
+    template <typename DocumentPredicate>
+    void FindDocumentsInSegment(const Query& query, DocumentPredicate& document_predicate,
+                                const Segment* segment, int64_t first, int64_t last,
+                                RelevanceAccumulator& document_to_relevance, const OrdinalSet& excluded,
+                                TopDocuments& matched_documents) const;
  
+    // То же для неизменяемого сегмента с отсечением MaxScore по блокам: документ-кандидат
+    // берётся только из слов, без которых не набрать порог отбора, а остальные слова
+    // проверяются, пока оценка сверху релевантности остаётся выше порога
     template <typename DocumentPredicate>
-    vector<Document> FindAllDocuments(const Query& query,
-                                      DocumentPredicate document_predicate) const;
+    void FindDocumentsMaxScore(const Query& query, DocumentPredicate& document_predicate,
+                               const Segment& segment, uint32_t first_ordinal, uint32_t last_ordinal,
+                               const OrdinalSet& excluded, TopDocuments& matched_documents) const;
+ 
+    // Ищет документы со статусом status по разобранному в context запросу через кэш выдачи
+    void FindDocumentsByStatus(QueryContext& context, DocumentStatus status) const;
+    
+    // Ищет по разобранному в context запросу, результат записывается в context
+    template <typename DocumentPredicate>
+    void FindAllDocuments(QueryContext& context, DocumentPredicate& document_predicate) const;
     
     template <typename DocumentPredicate>
-    vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query,
+    vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, QueryContext& context,
                                       DocumentPredicate document_predicate) const;
     
     template <typename DocumentPredicate>
-    vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query,
+    vector<Document> FindAllDocuments(const std::execution::parallel_policy&, QueryContext& context,
                                       DocumentPredicate document_predicate) const;
 };
 
@@ -143,6 +432,13 @@ private:
         }
     }
 
+    template <typename Function>
+    void SearchServer::ForEachDocumentTerm(int document_id, Function function) const {
+        for (const TermFrequency& term_frequency : document_terms_[document_ordinals_.at(document_id)]) {
+            function(term_frequency.term);
+        }
+    }
+
     template <typename DocumentPredicate> 
     vector<Document> SearchServer::FindTopDocuments(string_view raw_query, 
                                       DocumentPredicate document_predicate) const { 
@@ -152,27 +448,35 @@ private:
     template <typename ExecutionPolicy, typename DocumentPredicate>
     vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, string_view raw_query,
                                       DocumentPredicate document_predicate) const{
-        const auto query = ParseQuery(false, raw_query); 
+        QueryContext& context = GetThreadContext();
+        ParseQuery(raw_query, context.words_, context.query_);
   
-        auto matched_documents = FindAllDocuments(policy, query, document_predicate); 
- 
-        sort(matched_documents.begin(), matched_documents.end(), 
-             [](const Document& lhs, const Document& rhs) { 
-                return lhs.relevance > rhs.relevance 
-                    || (abs(lhs.relevance - rhs.relevance) < PRESICION_RELEVANCE && lhs.rating > rhs.rating); 
-                }); 
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) { 
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT); 
-        } 
-        return matched_documents; 
+        return FindAllDocuments(policy, context, document_predicate); 
+    }
+
+    template <typename DocumentPredicate>
+    const vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, string_view raw_query,
+                                                           DocumentPredicate document_predicate) const {
+        ParseQuery(raw_query, context.words_, context.query_);
+        FindAllDocuments(context, document_predicate);
+        return context.result_;
     }
 
     template <typename ExecutionPolicy> 
     vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, 
                                       DocumentStatus status) const{ 
-        return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) { 
-                    return document_status == status; 
-               }); 
+        QueryContext& context = GetThreadContext();
+        ParseQuery(raw_query, context.words_, context.query_);
+        if (!query_cache_) {
+            return FindFilteredDocuments(policy, context, CompileStatusFilter(status));
+        }
+        vector<Document> result;
+        if (query_cache_->Find(context.query_, status, max_result_document_count_, index_version_, result)) {
+            return result;
+        }
+        result = FindFilteredDocuments(policy, context, CompileStatusFilter(status));
+        query_cache_->Insert(context.query_, status, max_result_document_count_, index_version_, result);
+        return result;
     } 
 
     template <typename ExecutionPolicy> 
@@ -180,78 +484,281 @@ private:
         return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL); 
     } 
 
+    template <typename ExecutionPolicy>
+    vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, string_view raw_query,
+                                                    const DocumentFilter& filter) const {
+        QueryContext& context = GetThreadContext();
+        ParseQuery(raw_query, context.words_, context.query_);
+        return FindFilteredDocuments(policy, context, CompileFilter(filter, context));
+    }
+
+    template <typename ExecutionPolicy>
+    vector<Document> SearchServer::FindFilteredDocuments(const ExecutionPolicy& policy, QueryContext& context,
+                                                         const CompiledFilter& filter) const {
+        if (SelectCandidates(filter, context)) {
+            FindCandidateDocuments(context);
+            return context.result_;
+        }
+        return FindAllDocuments(policy, context, filter);
+    }
 
     template <typename DocumentPredicate>
-    vector<Document> SearchServer::FindAllDocuments( const Query& query,
-                                      DocumentPredicate document_predicate) const {
-        map<int, double> document_to_relevance;
-        for (string_view word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
+    bool SearchServer::AcceptDocument(DocumentPredicate& document_predicate, uint32_t ordinal) const {
+        const auto& document_data = documents_[ordinal];
+        if constexpr (is_same_v<remove_const_t<DocumentPredicate>, CompiledFilter>) {
+            return (document_predicate.status_mask >> static_cast<int>(document_data.status) & 1) != 0
+                && document_data.rating >= document_predicate.min_rating
+                && document_data.rating <= document_predicate.max_rating
+                && (document_predicate.allowed_ordinals == nullptr
+                    || document_predicate.allowed_ordinals->Contains(ordinal));
+        } else {
+            return document_predicate(document_data.id, document_data.status, document_data.rating);
+        }
+    }
+
+
+    template <typename DocumentPredicate>
+    void SearchServer::FindDocumentsInSegment(const Query& query, DocumentPredicate& document_predicate,
+                                              const Segment* segment, int64_t first, int64_t last,
+                                              RelevanceAccumulator& document_to_relevance, const OrdinalSet& excluded,
+                                              TopDocuments& matched_documents) const {
+        // function(uint32_t ordinal, double term_freq)
+        const auto for_each_posting = [&](TermId term, auto function) {
+            if (segment == nullptr) {
+                term_data_[term].postings.ForEach(static_cast<int>(first), static_cast<int>(last),
+                    [&function](const Posting& posting) {
+                        function(posting.ordinal, posting.term_freq);
+                    });
+            } else {
+                segment->ForEach(term, static_cast<uint32_t>(first), static_cast<uint32_t>(last), function);
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        };
+        if (segment != nullptr && dynamic_pruning_) {
+            FindDocumentsMaxScore(query, document_predicate, *segment, static_cast<uint32_t>(first),
+                                  static_cast<uint32_t>(last), excluded, matched_documents);
+            return;
+        }
+        document_to_relevance.Reset(documents_.size());
+        const bool has_excluded = !excluded.empty();
+        for (TermId term : query.plus_words) {
+            const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_data_[term]);
+            for_each_posting(term, [&](uint32_t ordinal, double term_freq) {
+                // удалённые документы остаются в неизменяемых сегментах до слияния
+                if ((segment != nullptr && segments_->IsDead(ordinal)) || (has_excluded && excluded.Contains(ordinal))) {
+                    return;
+                }
+                if (AcceptDocument(document_predicate, ordinal)) {
+                    document_to_relevance.Add(ordinal, term_freq * inverse_document_freq);
                 }
+            });
+        }
+
+        document_to_relevance.ForEach([&](uint32_t ordinal, double relevance) {
+            const auto& document_data = documents_[ordinal];
+            matched_documents.Push({document_data.id, relevance, document_data.rating});
+        });
+    }
+
+    template <typename DocumentPredicate>
+    void SearchServer::FindDocumentsMaxScore(const Query& query, DocumentPredicate& document_predicate,
+                                             const Segment& segment, uint32_t first_ordinal, uint32_t last_ordinal,
+                                             const OrdinalSet& excluded, TopDocuments& matched_documents) const {
+        // оценки сверху складываются в другом порядке, чем релевантность, и могут
+        // отличаться от неё на ошибку округления
+        constexpr double ROUNDING_SLACK = 1e-9;
+        MaxScoreBuffers& buffers = GetThreadMaxScoreBuffers();
+        auto& terms = buffers.terms;
+        terms.clear();
+        for (TermId term : query.plus_words) {
+            Segment::Cursor cursor(segment, term, first_ordinal, last_ordinal);
+            if (cursor.GetOrdinal() != Segment::Cursor::END) {
+                const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_data_[term]);
+                terms.push_back({cursor, inverse_document_freq, cursor.GetMaxTermFreq() * inverse_document_freq, 0.0});
             }
         }
-        for (string_view word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
+        auto& order = buffers.order;
+        order.clear();
+        for (MaxScoreTerm& term : terms) {
+            order.push_back(&term);
+        }
+        sort(order.begin(), order.end(),
+             [](const MaxScoreTerm* lhs, const MaxScoreTerm* rhs) { return lhs->max_score < rhs->max_score; });
+        auto& max_score_sums = buffers.max_score_sums;
+        max_score_sums.clear();
+        for (const MaxScoreTerm* term : order) {
+            max_score_sums.push_back((max_score_sums.empty() ? 0.0 : max_score_sums.back()) + term->max_score);
+        }
+
+        const bool has_excluded = !excluded.empty();
+        double threshold = matched_documents.GetRelevanceThreshold() - ROUNDING_SLACK;
+        // Слова order[0, essential) вместе не набирают порога, так что документ только с ними
+        // в отбор не попадёт и кандидаты берутся из остальных. Порог только растёт.
+        size_t essential = 0;
+        const auto update_essential = [&] {
+            while (essential < order.size() && max_score_sums[essential] <= threshold) {
+                ++essential;
+            }
+        };
+        update_essential();
+        while (essential < order.size()) {
+            uint64_t candidate = Segment::Cursor::END;
+            for (size_t i = essential; i < order.size(); ++i) {
+                candidate = min(candidate, order[i]->cursor.GetOrdinal());
+            }
+            if (candidate == Segment::Cursor::END) {
+                break;
+            }
+            const uint32_t ordinal = static_cast<uint32_t>(candidate);
+            if (has_excluded && excluded.Contains(ordinal)) {
+                for (size_t i = essential; i < order.size(); ++i) {
+                    if (order[i]->cursor.GetOrdinal() == candidate) {
+                        order[i]->cursor.Next();
+                    }
+                }
                 continue;
             }
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                document_to_relevance.erase(document_id);
+            double score = 0.0;
+            for (size_t i = essential; i < order.size(); ++i) {
+                const MaxScoreTerm& term = *order[i];
+                if (term.cursor.GetOrdinal() == candidate) {
+                    score += term.cursor.GetTermFreq() * term.inverse_document_freq;
+                }
+            }
+            // остальные слова досчитываются от самого весомого, пока кандидат не отсечён
+            double rest_score = 0.0;
+            for (size_t i = 0; i < essential; ++i) {
+                MaxScoreTerm& term = *order[i];
+                term.block_max_score = term.cursor.GetBlockMaxTermFreq(candidate) * term.inverse_document_freq;
+                rest_score += term.block_max_score;
+            }
+            for (size_t i = essential; i > 0 && score + rest_score > threshold; --i) {
+                MaxScoreTerm& term = *order[i - 1];
+                rest_score -= term.block_max_score;
+                if (term.block_max_score > 0.0) {
+                    term.cursor.SeekTo(candidate);
+                    if (term.cursor.GetOrdinal() == candidate) {
+                        score += term.cursor.GetTermFreq() * term.inverse_document_freq;
+                    }
+                }
+            }
+
+            // документ проверяется только после отсечения: так реже приходится читать его данные
+            if (score + rest_score > threshold && !segments_->IsDead(ordinal)
+                && AcceptDocument(document_predicate, ordinal)) {
+                // релевантность складывается в порядке слов запроса, как и без отсечения
+                double relevance = 0.0;
+                for (const MaxScoreTerm& term : terms) {
+                    if (term.cursor.GetOrdinal() == candidate) {
+                        relevance += term.cursor.GetTermFreq() * term.inverse_document_freq;
+                    }
+                }
+                const auto& document_data = documents_[ordinal];
+                matched_documents.Push({document_data.id, relevance, document_data.rating});
+                threshold = matched_documents.GetRelevanceThreshold() - ROUNDING_SLACK;
+                update_essential();
+            }
+            for (size_t i = essential; i < order.size(); ++i) {
+                if (order[i]->cursor.GetOrdinal() == candidate) {
+                    order[i]->cursor.Next();
+                }
             }
         }
- 
-        vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance) {
-            matched_documents.push_back(
-                {document_id, relevance, documents_.at(document_id).rating});
+    }
+
+    template <typename DocumentPredicate>
+    void SearchServer::FindAllDocuments(QueryContext& context, DocumentPredicate& document_predicate) const {
+        context.top_documents_.Reset(max_result_document_count_);
+        const auto segments = segments_->GetSegments();
+        CollectExcludedDocuments(context.query_, *segments, context.excluded_);
+        {
+            PROFILE_DURATION("search.postings"s);
+            // документ лежит ровно в одном сегменте, так что лучшие документы сегментов
+            // можно отбирать в общий топ
+            FindDocumentsInSegment(context.query_, document_predicate, nullptr, numeric_limits<int>::min(),
+                                   numeric_limits<int>::max(), context.accumulator_, context.excluded_,
+                                   context.top_documents_);
+            for (const auto& segment : *segments) {
+                FindDocumentsInSegment(context.query_, document_predicate, segment.get(), 0,
+                                       numeric_limits<uint32_t>::max(), context.accumulator_, context.excluded_,
+                                       context.top_documents_);
+            }
         }
-        return matched_documents;
+        PROFILE_DURATION("search.sort"s);
+        context.top_documents_.ExtractTo(context.result_);
     }
 
     template <typename DocumentPredicate>
-    vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query,
+    vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, QueryContext& context,
                                       DocumentPredicate document_predicate) const{
-        return FindAllDocuments(query, document_predicate);
+        FindAllDocuments(context, document_predicate);
+        return context.result_;
     }
 
     template <typename DocumentPredicate>
-    vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query,
+    vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, QueryContext& context,
                                       DocumentPredicate document_predicate) const{
-         ConcurrentMap<int, double> document_to_relevance(100);
-        for_each(std::execution::par, 
-                query.plus_words.begin(),
-                query.plus_words.end(),
-                [&](std::string_view word){
-                    if (word_to_document_freqs_.count(word) != 0){
-                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                    for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                        const auto& document_data = documents_.at(document_id);
-                        if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                            document_to_relevance[document_id] += term_freq * inverse_document_freq;
-                        }
-                    }}
-                });
-        for_each (std::execution::par, 
-                query.minus_words.begin(),
-                query.minus_words.end(),
-                [&](std::string_view word) {
-                    if (word_to_document_freqs_.count(word) != 0) {
-                for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                    document_to_relevance.Erase(document_id);
-                }}
-            });
-         vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-            matched_documents.push_back(
-                {document_id, relevance, documents_.at(document_id).rating});
+        const Query& query = context.query_;
+        if (document_ids_.empty()) {
+            return {};
+        }
+        // Каждый сегмент делится на части пропорционально числу документов в нём: изменяемый -
+        // по диапазонам id, неизменяемые - по диапазонам порядковых номеров. Каждый поток считает
+        // свою часть в собственном аккумуляторе, так что потоки не делят никаких данных,
+        // кроме частичных топов на выходе.
+        struct SegmentPart {
+            const Segment* segment;
+            int64_t first;
+            int64_t last;
+        };
+        const auto segments = segments_->GetSegments();
+        size_t document_count = mutable_ordinals_.size();
+        for (const auto& segment : *segments) {
+            document_count += segment->GetOrdinals().size();
+        }
+        const size_t max_part_count = 4 * max(1u, thread::hardware_concurrency());
+        vector<SegmentPart> parts;
+        const auto add_parts = [&](const Segment* segment, int64_t first, int64_t last, size_t segment_document_count) {
+            if (segment_document_count == 0 || first > last) {
+                return;
+            }
+            const int64_t count = last - first + 1;
+            const int64_t part_count = min<int64_t>(
+                count, max<size_t>(1, max_part_count * segment_document_count / document_count));
+            for (int64_t part = 0; part < part_count; ++part) {
+                parts.push_back({segment, first + count * part / part_count, first + count * (part + 1) / part_count - 1});
+            }
+        };
+        add_parts(nullptr, *document_ids_.begin(), *document_ids_.rbegin(), mutable_ordinals_.size());
+        for (const auto& segment : *segments) {
+            add_parts(segment.get(), segment->GetOrdinals().front(), segment->GetOrdinals().back(),
+                      segment->GetOrdinals().size());
+        }
+
+        // минус-слова разбираются один раз, дальше потоки только читают множество
+        OrdinalSet& excluded = GetThreadExcluded();
+        CollectExcludedDocuments(query, *segments, excluded);
+        vector<TopDocuments> partial_documents(parts.size(), TopDocuments(max_result_document_count_));
+        vector<size_t> part_indexes(parts.size());
+        iota(part_indexes.begin(), part_indexes.end(), 0);
+        {
+            PROFILE_DURATION("search.postings"s);
+            for_each(std::execution::par, 
+                    part_indexes.begin(),
+                    part_indexes.end(),
+                    [&](size_t index) {
+                        const SegmentPart& part = parts[index];
+                        FindDocumentsInSegment(query, document_predicate, part.segment, part.first, part.last,
+                                               GetThreadAccumulator(), excluded, partial_documents[index]);
+                    });
         }
-        return matched_documents;
+        PROFILE_DURATION("search.sort"s);
+        return reduce(std::execution::par,
+                      partial_documents.begin(), partial_documents.end(),
+                      TopDocuments(max_result_document_count_),
+                      [](TopDocuments lhs, const TopDocuments& rhs) {
+                          lhs.Merge(rhs);
+                          return lhs;
+                      }).Extract();
     }
  
 void PrintMatchDocumentResult(int document_id, const vector<string>& words, DocumentStatus status);
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "segment.h"
+
+#include <limits>
+#include <stdexcept>
+
+static_assert(sizeof(PostingBlock) == 16);
+
+Segment::Segment(SegmentArray<TermId> terms, SegmentArray<uint32_t> term_blocks, SegmentArray<PostingBlock> blocks,
+                 SegmentArray<double> block_max_term_freqs, SegmentArray<uint8_t> data,
+                 SegmentArray<double> term_freqs, std::vector<uint32_t> ordinals, std::shared_ptr<const void> owner)
+    : terms_(std::move(terms))
+    , term_blocks_(std::move(term_blocks))
+    , blocks_(std::move(blocks))
+    , block_max_term_freqs_(std::move(block_max_term_freqs))
+    , data_(std::move(data))
+    , term_freqs_(std::move(term_freqs))
+    , ordinals_(std::move(ordinals))
+    , owner_(std::move(owner)) {
+    for (const PostingBlock& block : blocks_) {
+        posting_count_ += block.size;
+    }
+}
+
+bool Segment::Contains(TermId term, uint32_t ordinal) const {
+    const auto [first_block, last_block] = FindBlocks(term);
+    const PostingBlock* block = std::partition_point(first_block, last_block, [ordinal](const PostingBlock& block) {
+        return block.last_ordinal < ordinal;
+    });
+    if (block == last_block || ordinal < block->first_ordinal) {
+        return false;
+    }
+    if (ordinal == block->first_ordinal || ordinal == block->last_ordinal) {
+        return true;
+    }
+    const uint8_t* ordinal_data = data_.begin() + block->offset;
+    uint32_t current = block->first_ordinal;
+    for (size_t i = 1; i < block->size && current < ordinal; ++i) {
+        current += Unpack(ordinal_data, i - 1, block->ordinal_bits) + 1;
+    }
+    return current == ordinal;
+}
+
+size_t Segment::EstimatePostingCount(TermId term) const {
+    const auto [first_block, last_block] = FindBlocks(term);
+    return (last_block - first_block) * SEGMENT_BLOCK_SIZE;
+}
+
+size_t Segment::GetMemoryUsage() const {
+    return terms_.GetMemoryUsage() + term_blocks_.GetMemoryUsage() + blocks_.GetMemoryUsage()
+        + block_max_term_freqs_.GetMemoryUsage() + data_.GetMemoryUsage() + term_freqs_.GetMemoryUsage() + ordinals_.capacity() * sizeof(uint32_t);
+}
+
+void Segment::Save(SnapshotWriter& writer) const {
+    writer.WriteArray(terms_.begin(), terms_.size());
+    writer.WriteArray(term_blocks_.begin(), term_blocks_.size());
+    writer.WriteArray(blocks_.begin(), blocks_.size());
+    writer.WriteArray(block_max_term_freqs_.begin(), block_max_term_freqs_.size());
+    writer.WriteArray(data_.begin(), data_.size());
+    writer.WriteArray(term_freqs_.begin(), term_freqs_.size());
+}
+
+std::shared_ptr<const Segment> Segment::Load(SnapshotReader& reader, std::vector<uint32_t> ordinals,
+                                             std::shared_ptr<const MappedFile> file) {
+    size_t term_count = 0;
+    const TermId* terms = reader.ReadArray<TermId>(term_count);
+    size_t term_block_count = 0;
+    const uint32_t* term_blocks = reader.ReadArray<uint32_t>(term_block_count);
+    size_t block_count = 0;
+    const PostingBlock* blocks = reader.ReadArray<PostingBlock>(block_count);
+    size_t block_max_term_freq_count = 0;
+    const double* block_max_term_freqs = reader.ReadArray<double>(block_max_term_freq_count);
+    size_t data_size = 0;
+    const uint8_t* data = reader.ReadArray<uint8_t>(data_size);
+    size_t term_freq_count = 0;
+    const double* term_freqs = reader.ReadArray<double>(term_freq_count);
+
+    auto check = [](bool condition) {
+        if (!condition) {
+            throw std::runtime_error("Segment is corrupted");
+        }
+    };
+    check(term_block_count == term_count + 1 && term_blocks[0] == 0 && term_blocks[term_count] == block_count
+          && block_max_term_freq_count == block_count);
+    for (size_t i = 0; i < term_count; ++i) {
+        check(term_blocks[i] < term_blocks[i + 1] && (i == 0 || terms[i - 1] < terms[i]));
+    }
+    // номера вне сегмента не должны попасть в массивы документов
+    const uint32_t max_ordinal = ordinals.empty() ? 0 : ordinals.back();
+    check(block_count == 0 || !ordinals.empty());
+    for (size_t i = 0; i < block_count; ++i) {
+        const PostingBlock& block = blocks[i];
+        check(block.last_ordinal <= max_ordinal && block.size > 0 && block.size <= SEGMENT_BLOCK_SIZE && block.first_ordinal <= block.last_ordinal
+              && block.ordinal_bits <= 32 && block.term_freq_bits <= 32
+              && (uint64_t{1} << block.term_freq_bits) <= term_freq_count);
+        const size_t packed_size = ((block.size - 1) * block.ordinal_bits + 7) / 8
+            + (block.size * block.term_freq_bits + 7) / 8;
+        check(block.offset <= data_size && packed_size + sizeof(uint64_t) <= data_size - block.offset);
+    }
+    return std::make_shared<const Segment>(SegmentArray<TermId>(terms, term_count),
+                                           SegmentArray<uint32_t>(term_blocks, term_block_count),
+                                           SegmentArray<PostingBlock>(blocks, block_count),
+                                           SegmentArray<double>(block_max_term_freqs, block_count),
+                                           SegmentArray<uint8_t>(data, data_size),
+                                           SegmentArray<double>(term_freqs, term_freq_count),
+                                           std::move(ordinals), std::move(file));
+}
+
+std::pair<const PostingBlock*, const PostingBlock*> Segment::FindBlocks(TermId term) const {
+    const TermId* it = std::lower_bound(terms_.begin(), terms_.end(), term);
+    if (it == terms_.end() || *it != term) {
+        return {nullptr, nullptr};
+    }
+    const size_t index = it - terms_.begin();
+    return {blocks_.begin() + term_blocks_[index], blocks_.begin() + term_blocks_[index + 1]};
+}
+
+Segment::Cursor::Cursor(const Segment& segment, TermId term, uint32_t first_ordinal, uint32_t last_ordinal)
+    : segment_(&segment)
+    , last_ordinal_(last_ordinal) {
+    const auto [first_block, last_block] = segment.FindBlocks(term);
+    last_block_ = last_block;
+    shallow_block_ = std::partition_point(first_block, last_block, [first_ordinal](const PostingBlock& block) {
+        return block.last_ordinal < first_ordinal;
+    });
+    for (const PostingBlock* block = shallow_block_; block != last_block && block->first_ordinal <= last_ordinal;
+         ++block) {
+        max_term_freq_ = std::max(max_term_freq_, segment.block_max_term_freqs_[block - segment.blocks_.begin()]);
+    }
+    EnterBlock(shallow_block_);
+    SeekTo(first_ordinal);
+    if (ordinal_ > last_ordinal_) {
+        ordinal_ = END;
+    }
+}
+
+void SegmentBuilder::Add(TermId term, uint32_t ordinal, double term_freq) {
+    if (terms_.empty() || terms_.back() != term) {
+        FlushBlock();
+        terms_.push_back(term);
+        term_blocks_.push_back(blocks_.size());
+    } else if (block_size_ == SEGMENT_BLOCK_SIZE) {
+        FlushBlock();
+    }
+    uint64_t term_freq_bits;
+    std::memcpy(&term_freq_bits, &term_freq, sizeof(term_freq));
+    const auto [it, inserted] = term_freq_codes_.emplace(term_freq_bits, term_freqs_.size());
+    if (inserted) {
+        term_freqs_.push_back(term_freq);
+    }
+    block_ordinals_[block_size_] = ordinal;
+    block_term_freq_codes_[block_size_] = it->second;
+    block_max_term_freq_ = block_size_ == 0 ? term_freq : std::max(block_max_term_freq_, term_freq);
+    ++block_size_;
+}
+
+std::shared_ptr<const Segment> SegmentBuilder::Build(std::vector<uint32_t> ordinals) {
+    FlushBlock();
+    term_blocks_.push_back(blocks_.size());
+    // запас для чтения упакованных чисел по 8 байт
+    data_.resize(data_.size() + sizeof(uint64_t), 0);
+    // словарь частот дополняется до степени двойки, чтобы любой код ширины блока был в нём
+    if (!term_freqs_.empty()) {
+        size_t size = 1;
+        while (size < term_freqs_.size()) {
+            size *= 2;
+        }
+        term_freqs_.resize(size, term_freqs_.back());
+    }
+    data_.shrink_to_fit();
+    blocks_.shrink_to_fit();
+    block_max_term_freqs_.shrink_to_fit();
+    term_freqs_.shrink_to_fit();
+    return std::make_shared<const Segment>(SegmentArray<TermId>(std::move(terms_)),
+                                           SegmentArray<uint32_t>(std::move(term_blocks_)),
+                                           SegmentArray<PostingBlock>(std::move(blocks_)),
+                                           SegmentArray<double>(std::move(block_max_term_freqs_)),
+                                           SegmentArray<uint8_t>(std::move(data_)),
+                                           SegmentArray<double>(std::move(term_freqs_)),
+                                           std::move(ordinals));
+}
+
+void SegmentBuilder::FlushBlock() {
+    if (block_size_ == 0) {
+        return;
+    }
+    if (data_.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("Segment is too large");
+    }
+    const uint32_t first_ordinal = block_ordinals_[0];
+    const uint32_t last_ordinal = block_ordinals_[block_size_ - 1];
+    // разности соседних номеров больше нуля, поэтому хранятся без единицы
+    uint32_t max_delta = 0;
+    uint32_t previous_ordinal = first_ordinal;
+    for (size_t i = 1; i < block_size_; ++i) {
+        const uint32_t ordinal = block_ordinals_[i];
+        block_ordinals_[i - 1] = ordinal - previous_ordinal - 1;
+        max_delta = std::max(max_delta, block_ordinals_[i - 1]);
+        previous_ordinal = ordinal;
+    }
+    const uint32_t max_code = *std::max_element(block_term_freq_codes_, block_term_freq_codes_ + block_size_);
+    auto bit_width = [](uint32_t value) {
+        unsigned bits = 0;
+        for (; value != 0; value >>= 1) {
+            ++bits;
+        }
+        return bits;
+    };
+
+    PostingBlock block;
+    block.first_ordinal = first_ordinal;
+    block.last_ordinal = last_ordinal;
+    block.offset = static_cast<uint32_t>(data_.size());
+    block.size = static_cast<uint16_t>(block_size_);
+    block.ordinal_bits = static_cast<uint8_t>(bit_width(max_delta));
+    block.term_freq_bits = static_cast<uint8_t>(bit_width(max_code));
+    Pack(block_ordinals_, block_size_ - 1, block.ordinal_bits);
+    Pack(block_term_freq_codes_, block_size_, block.term_freq_bits);
+    blocks_.push_back(block);
+    block_max_term_freqs_.push_back(block_max_term_freq_);
+    block_size_ = 0;
+}
+
+void SegmentBuilder::Pack(const uint32_t* values, size_t count, unsigned bits) {
+    const size_t begin = data_.size();
+    data_.resize(begin + (count * bits + 7) / 8, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const size_t bit = i * bits;
+        uint64_t value = static_cast<uint64_t>(values[i]) << (bit % 8);
+        for (size_t byte = begin + bit / 8; value != 0; ++byte, value >>= 8) {
+            data_[byte] |= static_cast<uint8_t>(value);
+        }
+    }
+}
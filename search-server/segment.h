@@ -0,0 +1,364 @@
+#pragma once
+
+#include "snapshot.h"
+#include "term_dictionary.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Блок из не более чем SEGMENT_BLOCK_SIZE вхождений слова в сжатом виде.
+// Блоки слова упорядочены по порядковым номерам документов и служат указателями
+// пропуска: по first_ordinal/last_ordinal блок проверяется без распаковки.
+struct PostingBlock {
+    uint32_t first_ordinal;
+    uint32_t last_ordinal;
+    // начало упакованных данных блока в Segment::data_
+    uint32_t offset;
+    uint16_t size;
+    // ширина в битах разностей соседних номеров (минус один) и кодов частот
+    uint8_t ordinal_bits;
+    uint8_t term_freq_bits;
+};
+
+const size_t SEGMENT_BLOCK_SIZE = 128;
+
+// Массив, принадлежащий сегменту или лежащий во внешней памяти
+template <typename T>
+class SegmentArray {
+public:
+    SegmentArray() = default;
+
+    explicit SegmentArray(std::vector<T> values)
+        : values_(std::move(values))
+        , data_(values_.data())
+        , size_(values_.size()) {
+    }
+
+    SegmentArray(const T* data, size_t size)
+        : data_(data)
+        , size_(size) {
+    }
+
+    const T* begin() const {
+        return data_;
+    }
+
+    const T* end() const {
+        return data_ + size_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    const T& operator[](size_t index) const {
+        return data_[index];
+    }
+
+    // Память под собственный массив в байтах
+    size_t GetMemoryUsage() const {
+        return values_.capacity() * sizeof(T);
+    }
+
+private:
+    std::vector<T> values_;
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Неизменяемый сегмент индекса: сжатые вхождения части документов, сгруппированные
+// по id слова и упорядоченные внутри слова по порядковому номеру документа.
+// Номера хранятся разностями, упакованными в блоках с общей для блока шириной в битах,
+// частоты - кодами в словаре различных частот сегмента, так что значения не искажаются.
+// Вхождение обычно занимает 2-3 байта вместо 16 в PostingList.
+class Segment {
+public:
+    // term_blocks[i] - номер первого блока слова terms[i], term_blocks.back() == blocks.size();
+    // за данными блоков должно быть не меньше 8 байт; ordinals - отсортированные
+    // порядковые номера всех документов сегмента; owner держит внешнюю память массивов
+    // block_max_term_freqs[i] - наибольшая частота в блоке blocks[i]
+    Segment(SegmentArray<TermId> terms, SegmentArray<uint32_t> term_blocks, SegmentArray<PostingBlock> blocks,
+            SegmentArray<double> block_max_term_freqs, SegmentArray<uint8_t> data, SegmentArray<double> term_freqs,
+            std::vector<uint32_t> ordinals, std::shared_ptr<const void> owner = nullptr);
+
+    class Cursor;
+
+    Segment(const Segment&) = delete;
+    Segment& operator=(const Segment&) = delete;
+
+    // Обходит вхождения слова в документы с номерами из отрезка [first_ordinal, last_ordinal]
+    // в порядке возрастания номера, вызывая function(uint32_t ordinal, double term_freq)
+    template <typename Function>
+    void ForEach(TermId term, uint32_t first_ordinal, uint32_t last_ordinal, Function function) const;
+
+    // Проверяет вхождение слова в документ, распаковывая не больше одного блока
+    bool Contains(TermId term, uint32_t ordinal) const;
+
+    // Оценка сверху числа вхождений слова без распаковки
+    size_t EstimatePostingCount(TermId term) const;
+
+    size_t GetPostingCount() const {
+        return posting_count_;
+    }
+
+    const std::vector<uint32_t>& GetOrdinals() const {
+        return ordinals_;
+    }
+
+    // Собственная память сегмента в байтах, внешние массивы не учитываются
+    size_t GetMemoryUsage() const;
+
+    // Записывает массивы сегмента, кроме номеров документов
+    void Save(SnapshotWriter& writer) const;
+
+    // Читает сегмент, записанный Save, прямо из отображённого файла file.
+    // Выбрасывает runtime_error, если массивы не согласованы.
+    static std::shared_ptr<const Segment> Load(SnapshotReader& reader, std::vector<uint32_t> ordinals,
+                                               std::shared_ptr<const MappedFile> file);
+
+    // Сливает сегменты, выбрасывая вхождения документов, для которых is_dead(ordinal),
+    // и заменяя порядковые номера остальных на renumber(ordinal); renumber сохраняет порядок.
+    // Возвращает nullptr, если живых документов не осталось.
+    template <typename IsDead, typename Renumber>
+    static std::shared_ptr<const Segment> Merge(const std::vector<std::shared_ptr<const Segment>>& segments,
+                                                IsDead is_dead, Renumber renumber);
+
+private:
+    SegmentArray<TermId> terms_;
+    SegmentArray<uint32_t> term_blocks_;
+    SegmentArray<PostingBlock> blocks_;
+    SegmentArray<double> block_max_term_freqs_;
+    SegmentArray<uint8_t> data_;
+    SegmentArray<double> term_freqs_;
+    std::vector<uint32_t> ordinals_;
+    std::shared_ptr<const void> owner_;
+    size_t posting_count_ = 0;
+
+    // Блоки слова [first, last), пустой отрезок, если слова в сегменте нет
+    std::pair<const PostingBlock*, const PostingBlock*> FindBlocks(TermId term) const;
+
+    // Значение номер index из упакованных по bits бит чисел, начинающихся в data
+    static uint32_t Unpack(const uint8_t* data, size_t index, unsigned bits) {
+        const size_t bit = index * bits;
+        uint64_t word;
+        std::memcpy(&word, data + bit / 8, sizeof(word));
+        return static_cast<uint32_t>((word >> (bit % 8)) & ((uint64_t{1} << bits) - 1));
+    }
+
+    template <typename Function>
+    void ForEachInBlock(const PostingBlock& block, Function& function) const;
+};
+
+// Собирает сегмент из вхождений, добавляемых по возрастанию id слова,
+// а внутри слова - по возрастанию порядкового номера документа
+class SegmentBuilder {
+public:
+    void Add(TermId term, uint32_t ordinal, double term_freq);
+
+    // ordinals - отсортированные порядковые номера всех документов сегмента
+    std::shared_ptr<const Segment> Build(std::vector<uint32_t> ordinals);
+
+private:
+    std::vector<TermId> terms_;
+    std::vector<uint32_t> term_blocks_;
+    std::vector<PostingBlock> blocks_;
+    std::vector<double> block_max_term_freqs_;
+    std::vector<uint8_t> data_;
+    std::vector<double> term_freqs_;
+    // код частоты по её двоичному представлению
+    std::unordered_map<uint64_t, uint32_t> term_freq_codes_;
+
+    uint32_t block_ordinals_[SEGMENT_BLOCK_SIZE];
+    uint32_t block_term_freq_codes_[SEGMENT_BLOCK_SIZE];
+    double block_max_term_freq_ = 0.0;
+    size_t block_size_ = 0;
+
+    void FlushBlock();
+
+    // Дописывает count чисел по bits бит в data_
+    void Pack(const uint32_t* values, size_t count, unsigned bits);
+};
+
+// Курсор по вхождениям слова в документы с номерами из отрезка [first_ordinal, last_ordinal]
+// в порядке возрастания номера. Распаковывает блоки по одному вхождению и только те,
+// в которые заходит, а частоту - только по запросу.
+class Segment::Cursor {
+public:
+    // Номер за последним вхождением, когда курсор исчерпан
+    static constexpr uint64_t END = uint64_t{1} << 32;
+
+    Cursor(const Segment& segment, TermId term, uint32_t first_ordinal, uint32_t last_ordinal);
+
+    uint64_t GetOrdinal() const {
+        return ordinal_;
+    }
+
+    double GetTermFreq() const {
+        const uint8_t* term_freq_data = segment_->data_.begin() + block_->offset
+            + ((block_->size - 1) * block_->ordinal_bits + 7) / 8;
+        return segment_->term_freqs_[Unpack(term_freq_data, index_, block_->term_freq_bits)];
+    }
+
+    // Наибольшая частота среди вхождений курсора
+    double GetMaxTermFreq() const {
+        return max_term_freq_;
+    }
+
+    void Next() {
+        if (index_ + 1 < block_->size) {
+            ordinal_ += Unpack(segment_->data_.begin() + block_->offset, index_, block_->ordinal_bits) + 1;
+            ++index_;
+        } else {
+            EnterBlock(block_ + 1);
+        }
+        if (ordinal_ > last_ordinal_) {
+            ordinal_ = END;
+        }
+    }
+
+    // Переходит к первому вхождению с номером не меньше ordinal
+    void SeekTo(uint64_t ordinal) {
+        if (ordinal_ >= ordinal) {
+            return;
+        }
+        if (block_->last_ordinal < ordinal) {
+            const PostingBlock* block = std::max(block_ + 1, shallow_block_);
+            while (block != last_block_ && block->last_ordinal < ordinal) {
+                ++block;
+            }
+            EnterBlock(block);
+        }
+        while (ordinal_ < ordinal) {
+            ordinal_ += Unpack(segment_->data_.begin() + block_->offset, index_, block_->ordinal_bits) + 1;
+            ++index_;
+        }
+        if (ordinal_ > last_ordinal_) {
+            ordinal_ = END;
+        }
+    }
+
+    // Оценка сверху частоты в документе ordinal без распаковки: наибольшая частота блока,
+    // в диапазон которого попадает ordinal, или 0, если такого блока нет.
+    // Номера при последовательных вызовах не должны убывать.
+    double GetBlockMaxTermFreq(uint64_t ordinal) {
+        while (shallow_block_ != last_block_ && shallow_block_->last_ordinal < ordinal) {
+            ++shallow_block_;
+        }
+        if (shallow_block_ == last_block_ || ordinal < shallow_block_->first_ordinal) {
+            return 0.0;
+        }
+        return segment_->block_max_term_freqs_[shallow_block_ - segment_->blocks_.begin()];
+    }
+
+private:
+    const Segment* segment_;
+    const PostingBlock* block_;
+    const PostingBlock* last_block_;
+    const PostingBlock* shallow_block_;
+    uint32_t last_ordinal_;
+    uint64_t ordinal_ = END;
+    size_t index_ = 0;
+    double max_term_freq_ = 0.0;
+
+    void EnterBlock(const PostingBlock* block) {
+        block_ = block;
+        index_ = 0;
+        ordinal_ = block == last_block_ ? END : block->first_ordinal;
+    }
+};
+
+template <typename Function>
+void Segment::ForEachInBlock(const PostingBlock& block, Function& function) const {
+    const uint8_t* ordinal_data = data_.begin() + block.offset;
+    const uint8_t* term_freq_data = ordinal_data + ((block.size - 1) * block.ordinal_bits + 7) / 8;
+    uint32_t ordinal = block.first_ordinal;
+    function(ordinal, term_freqs_[Unpack(term_freq_data, 0, block.term_freq_bits)]);
+    for (size_t i = 1; i < block.size; ++i) {
+        ordinal += Unpack(ordinal_data, i - 1, block.ordinal_bits) + 1;
+        function(ordinal, term_freqs_[Unpack(term_freq_data, i, block.term_freq_bits)]);
+    }
+}
+
+template <typename Function>
+void Segment::ForEach(TermId term, uint32_t first_ordinal, uint32_t last_ordinal, Function function) const {
+    auto [block, last_block] = FindBlocks(term);
+    // указатели пропуска: блоки целиком до first_ordinal не распаковываются
+    block = std::partition_point(block, last_block, [first_ordinal](const PostingBlock& block) {
+        return block.last_ordinal < first_ordinal;
+    });
+    for (; block != last_block && block->first_ordinal <= last_ordinal; ++block) {
+        if (first_ordinal <= block->first_ordinal && block->last_ordinal <= last_ordinal) {
+            ForEachInBlock(*block, function);
+        } else {
+            const auto in_range = [&](uint32_t ordinal, double term_freq) {
+                if (first_ordinal <= ordinal && ordinal <= last_ordinal) {
+                    function(ordinal, term_freq);
+                }
+            };
+            ForEachInBlock(*block, in_range);
+        }
+    }
+}
+
+template <typename IsDead, typename Renumber>
+std::shared_ptr<const Segment> Segment::Merge(const std::vector<std::shared_ptr<const Segment>>& segments,
+                                              IsDead is_dead, Renumber renumber) {
+    std::vector<uint32_t> ordinals;
+    for (const auto& segment : segments) {
+        for (const uint32_t ordinal : segment->ordinals_) {
+            if (!is_dead(ordinal)) {
+                ordinals.push_back(renumber(ordinal));
+            }
+        }
+    }
+    if (ordinals.empty()) {
+        return nullptr;
+    }
+    std::sort(ordinals.begin(), ordinals.end());
+
+    // документы сегментов не пересекаются, поэтому вхождения слова из разных сегментов
+    // достаточно слить по номеру
+    SegmentBuilder builder;
+    std::vector<std::pair<uint32_t, double>> postings;
+    std::vector<size_t> term_indexes(segments.size(), 0);
+    for (;;) {
+        TermId term = TermDictionary::NO_TERM;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (term_indexes[i] < segments[i]->terms_.size()) {
+                term = std::min(term, segments[i]->terms_[term_indexes[i]]);
+            }
+        }
+        if (term == TermDictionary::NO_TERM) {
+            break;
+        }
+        postings.clear();
+        for (size_t i = 0; i < segments.size(); ++i) {
+            const Segment& segment = *segments[i];
+            if (term_indexes[i] == segment.terms_.size() || segment.terms_[term_indexes[i]] != term) {
+                continue;
+            }
+            const size_t run_begin = postings.size();
+            auto add_posting = [&](uint32_t ordinal, double term_freq) {
+                if (!is_dead(ordinal)) {
+                    postings.push_back({renumber(ordinal), term_freq});
+                }
+            };
+            for (uint32_t block = segment.term_blocks_[term_indexes[i]]; block < segment.term_blocks_[term_indexes[i] + 1];
+                 ++block) {
+                segment.ForEachInBlock(segment.blocks_[block], add_posting);
+            }
+            std::inplace_merge(postings.begin(), postings.begin() + run_begin, postings.end());
+            ++term_indexes[i];
+        }
+        for (const auto& [ordinal, term_freq] : postings) {
+            builder.Add(term, ordinal, term_freq);
+        }
+    }
+    return builder.Build(std::move(ordinals));
+}
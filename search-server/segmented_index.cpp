@@ -0,0 +1,179 @@
+#include "segmented_index.h"
+
+#include <array>
+
+SegmentedIndex::SegmentedIndex()
+    : segments_(std::make_shared<const SegmentList>()) {
+}
+
+SegmentedIndex::~SegmentedIndex() {
+    {
+        std::lock_guard lock(mutex_);
+        is_stopping_ = true;
+    }
+    merge_condition_.notify_all();
+    if (merge_thread_.joinable()) {
+        merge_thread_.join();
+    }
+}
+
+void SegmentedIndex::AddSegment(std::shared_ptr<const Segment> segment) {
+    {
+        std::lock_guard lock(mutex_);
+        auto segments = std::make_shared<SegmentList>(*segments_);
+        segments->push_back(std::move(segment));
+        std::atomic_store(&segments_, std::shared_ptr<const SegmentList>(std::move(segments)));
+        // поток заводится только у индекса, дошедшего до сегментов
+        if (!merge_thread_.joinable()) {
+            merge_thread_ = std::thread([this] { RunMerges(); });
+        }
+    }
+    merge_condition_.notify_all();
+}
+
+void SegmentedIndex::Kill(uint32_t ordinal) {
+    std::lock_guard lock(mutex_);
+    if (ordinal / 64 >= dead_.size()) {
+        dead_.resize(ordinal / 64 + 1, 0);
+    }
+    dead_[ordinal / 64] |= uint64_t{1} << (ordinal % 64);
+}
+
+void SegmentedIndex::Kill(const std::vector<uint32_t>& ordinals) {
+    {
+        std::lock_guard lock(mutex_);
+        for (const uint32_t ordinal : ordinals) {
+            if (ordinal / 64 >= dead_.size()) {
+                dead_.resize(ordinal / 64 + 1, 0);
+            }
+            dead_[ordinal / 64] |= uint64_t{1} << (ordinal % 64);
+        }
+    }
+    merge_condition_.notify_all();
+}
+
+std::vector<uint32_t> SegmentedIndex::TakeReleasedOrdinals() {
+    if (!has_released_ordinals_.load(std::memory_order_acquire)) {
+        return {};
+    }
+    std::lock_guard lock(mutex_);
+    std::vector<uint32_t> ordinals;
+    ordinals.swap(released_ordinals_);
+    for (const uint32_t ordinal : ordinals) {
+        dead_[ordinal / 64] &= ~(uint64_t{1} << (ordinal % 64));
+    }
+    has_released_ordinals_.store(false, std::memory_order_relaxed);
+    return ordinals;
+}
+
+void SegmentedIndex::MergeAll(const std::vector<uint32_t>& new_ordinals) {
+    std::unique_lock lock(mutex_);
+    merge_condition_.wait(lock, [this] { return !is_merging_; });
+    const SegmentList segments = *segments_;
+    Merge(lock, segments, new_ordinals);
+}
+
+size_t SegmentedIndex::GetMemoryUsage() const {
+    const auto segments = GetSegments();
+    size_t memory = segments->capacity() * sizeof(std::shared_ptr<const Segment>);
+    for (const auto& segment : *segments) {
+        memory += sizeof(Segment) + segment->GetMemoryUsage();
+    }
+    std::lock_guard lock(mutex_);
+    return memory + dead_.capacity() * sizeof(uint64_t) + released_ordinals_.capacity() * sizeof(uint32_t);
+}
+
+SegmentedIndex::SegmentList SegmentedIndex::PickMerge() const {
+    // уровень сегмента - логарифм числа вхождений по основанию MERGE_FACTOR, так что
+    // каждое вхождение переписывается при слияниях O(log N) раз
+    constexpr size_t LEVEL_COUNT = 32;
+    std::array<SegmentList, LEVEL_COUNT> levels;
+    for (const auto& segment : *segments_) {
+        size_t level = 0;
+        for (size_t size = segment->GetPostingCount(); size >= MERGE_FACTOR && level + 1 < LEVEL_COUNT;
+             size /= MERGE_FACTOR) {
+            ++level;
+        }
+        levels[level].push_back(segment);
+        if (levels[level].size() == MERGE_FACTOR) {
+            return levels[level];
+        }
+    }
+    // после массового удаления сегмент может долго не дождаться своей очереди
+    // на слияние, так что он переписывается сам по себе
+    for (const auto& segment : *segments_) {
+        const auto& ordinals = segment->GetOrdinals();
+        const size_t dead_count = std::count_if(ordinals.begin(), ordinals.end(), [this](uint32_t ordinal) {
+            return IsDead(ordinal);
+        });
+        if (dead_count > 0 && dead_count * 2 >= ordinals.size()) {
+            return {segment};
+        }
+    }
+    return {};
+}
+
+void SegmentedIndex::Merge(std::unique_lock<std::mutex>& lock, const SegmentList& segments,
+                           const std::vector<uint32_t>& new_ordinals) {
+    is_merging_ = true;
+    // удаления после этой точки остаются в слитом сегменте до следующего слияния
+    const std::vector<uint64_t> dead = dead_;
+    lock.unlock();
+    const auto is_dead = [&dead](uint32_t ordinal) {
+        return ordinal / 64 < dead.size() && (dead[ordinal / 64] >> (ordinal % 64) & 1) != 0;
+    };
+    std::shared_ptr<const Segment> merged;
+    std::vector<uint32_t> released_ordinals;
+    if (new_ordinals.empty()) {
+        merged = Segment::Merge(segments, is_dead, [](uint32_t ordinal) { return ordinal; });
+        for (const auto& segment : segments) {
+            for (const uint32_t ordinal : segment->GetOrdinals()) {
+                if (is_dead(ordinal)) {
+                    released_ordinals.push_back(ordinal);
+                }
+            }
+        }
+    } else {
+        merged = Segment::Merge(segments, is_dead, [&new_ordinals](uint32_t ordinal) { return new_ordinals[ordinal]; });
+    }
+    lock.lock();
+    if (!new_ordinals.empty()) {
+        dead_.clear();
+        released_ordinals_.clear();
+    }
+
+    // пока шло слияние, в набор могли добавиться новые сегменты
+    auto result = std::make_shared<SegmentList>();
+    for (const auto& segment : *segments_) {
+        if (std::find(segments.begin(), segments.end(), segment) == segments.end()) {
+            result->push_back(segment);
+        } else if (segment == segments.front() && merged) {
+            result->push_back(merged);
+        }
+    }
+    std::atomic_store(&segments_, std::shared_ptr<const SegmentList>(std::move(result)));
+    released_ordinals_.insert(released_ordinals_.end(), released_ordinals.begin(), released_ordinals.end());
+    has_released_ordinals_.store(!released_ordinals_.empty(), std::memory_order_release);
+    is_merging_ = false;
+    merge_condition_.notify_all();
+}
+
+void SegmentedIndex::RunMerges() {
+    std::unique_lock lock(mutex_);
+    for (;;) {
+        SegmentList segments;
+        merge_condition_.wait(lock, [this, &segments] {
+            if (is_stopping_) {
+                return true;
+            }
+            if (!is_merging_) {
+                segments = PickMerge();
+            }
+            return !segments.empty();
+        });
+        if (is_stopping_) {
+            return;
+        }
+        Merge(lock, segments);
+    }
+}
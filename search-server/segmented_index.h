@@ -0,0 +1,85 @@
+#pragma once
+
+#include "segment.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Набор неизменяемых сегментов с битовой картой удалённых документов и фоновым слиянием.
+// Когда набирается MERGE_FACTOR сегментов одного уровня (близких по числу вхождений),
+// фоновый поток сливает их в один, выбрасывая вхождения удалённых документов, и
+// отдаёт порядковые номера этих документов через TakeReleasedOrdinals.
+// Поиск (GetSegments, IsDead) может идти одновременно со слиянием, но не с остальными методами.
+class SegmentedIndex {
+public:
+    using SegmentList = std::vector<std::shared_ptr<const Segment>>;
+
+    SegmentedIndex();
+
+    SegmentedIndex(const SegmentedIndex&) = delete;
+    SegmentedIndex& operator=(const SegmentedIndex&) = delete;
+
+    // Дожидается текущего слияния и останавливает фоновый поток
+    ~SegmentedIndex();
+
+    // Текущий набор сегментов; слияние не меняет полученный набор, а подменяет его новым
+    std::shared_ptr<const SegmentList> GetSegments() const {
+        return std::atomic_load(&segments_);
+    }
+
+    void AddSegment(std::shared_ptr<const Segment> segment);
+
+    // Отмечает удалённым документ из какого-либо сегмента
+    void Kill(uint32_t ordinal);
+
+    // Отмечает удалёнными пакет документов. Сегмент, в котором удалённых документов
+    // набралось не меньше половины, фоновый поток переписывает без них.
+    void Kill(const std::vector<uint32_t>& ordinals);
+
+    bool IsDead(uint32_t ordinal) const {
+        return ordinal / 64 < dead_.size() && (dead_[ordinal / 64] >> (ordinal % 64) & 1) != 0;
+    }
+
+    // Номера удалённых документов, вхождений которых больше нет ни в одном сегменте.
+    // Они снова считаются живыми и могут достаться новым документам.
+    std::vector<uint32_t> TakeReleasedOrdinals();
+
+    // Дожидается фонового слияния и сливает все сегменты в один. Если new_ordinals не пуст,
+    // документ с номером ordinal получает номер new_ordinals[ordinal], а номера удалённых
+    // документов не освобождаются, а просто забываются.
+    void MergeAll(const std::vector<uint32_t>& new_ordinals = {});
+
+    size_t GetMemoryUsage() const;
+
+private:
+    static constexpr size_t MERGE_FACTOR = 4;
+
+    mutable std::mutex mutex_;
+    std::condition_variable merge_condition_;
+    std::shared_ptr<const SegmentList> segments_;
+    // бит на порядковый номер документа
+    std::vector<uint64_t> dead_;
+    std::vector<uint32_t> released_ordinals_;
+    std::atomic<bool> has_released_ordinals_ = false;
+    bool is_merging_ = false;
+    bool is_stopping_ = false;
+    std::thread merge_thread_;
+
+    // Сегменты самого мелкого уровня, в котором их набралось MERGE_FACTOR, либо сегмент,
+    // наполовину состоящий из удалённых документов, либо пустой список
+    SegmentList PickMerge() const;
+
+    // Сливает segments без блокировки и подменяет их результатом; lock захвачен на входе и выходе
+    void Merge(std::unique_lock<std::mutex>& lock, const SegmentList& segments,
+               const std::vector<uint32_t>& new_ordinals = {});
+
+    void RunMerges();
+};
@@ -0,0 +1,77 @@
+#include "snapshot.h"
+
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+MappedFile::MappedFile(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Can't open "s + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw runtime_error("Can't stat "s + path);
+    }
+    size_ = file_stat.st_size;
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw runtime_error("Can't map "s + path);
+        }
+        data_ = static_cast<const char*>(data);
+    }
+    // отображение остаётся действительным и после закрытия дескриптора
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+SnapshotWriter::SnapshotWriter(const string& path)
+    : path_(path)
+    , temp_path_(path + ".tmp"s)
+    , out_(temp_path_, ios::binary | ios::trunc) {
+    if (!out_) {
+        throw runtime_error("Can't open "s + temp_path_ + " for writing"s);
+    }
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (!finished_) {
+        out_.close();
+        unlink(temp_path_.c_str());
+    }
+}
+
+void SnapshotWriter::Finish() {
+    out_.close();
+    if (!out_) {
+        throw runtime_error("Can't write snapshot"s);
+    }
+    // старый файл остаётся отображённым у прежних владельцев до munmap
+    if (rename(temp_path_.c_str(), path_.c_str()) != 0) {
+        throw runtime_error("Can't replace "s + path_);
+    }
+    finished_ = true;
+}
+
+void SnapshotWriter::WriteBytes(const void* data, size_t size) {
+    out_.write(static_cast<const char*>(data), size);
+    offset_ += size;
+}
+
+void SnapshotWriter::Align() {
+    static const char zeros[ALIGNMENT] = {};
+    WriteBytes(zeros, (ALIGNMENT - offset_ % ALIGNMENT) % ALIGNMENT);
+}
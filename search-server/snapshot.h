@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Двоичный снимок индекса: последовательность значений фиксированного размера,
+// строк (длина + байты) и массивов (длина + выровненные на 8 байт элементы).
+// Массивы читаются без копирования прямо из отображённого в память файла,
+// поэтому данные записываются в порядке байтов и представлении текущей платформы.
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    const char* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Пишет снимок во временный файл рядом с целевым и подменяет целевой только в Finish,
+// поэтому снимок можно сохранить поверх файла, из которого отображён сам сервер
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Удаляет временный файл, если Finish не был вызван
+    ~SnapshotWriter();
+
+    template <typename T>
+    void Write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        WriteBytes(&value, sizeof(value));
+    }
+
+    void WriteString(std::string_view text) {
+        Write<uint64_t>(text.size());
+        WriteBytes(text.data(), text.size());
+    }
+
+    template <typename T>
+    void WriteArray(const T* values, size_t count) {
+        BeginArray<T>(count);
+        WriteValues(values, count);
+    }
+
+    template <typename T>
+    void WriteArray(const std::vector<T>& values) {
+        WriteArray(values.data(), values.size());
+    }
+
+    // Начинает массив из count элементов, которые затем передаются в WriteValues
+    template <typename T>
+    void BeginArray(size_t count) {
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= ALIGNMENT);
+        Write<uint64_t>(count);
+        Align();
+    }
+
+    template <typename T>
+    void WriteValues(const T* values, size_t count) {
+        WriteBytes(values, count * sizeof(T));
+    }
+
+    // Закрывает временный файл и переименовывает его в целевой,
+    // выбрасывает runtime_error при ошибке записи
+    void Finish();
+
+private:
+    static constexpr size_t ALIGNMENT = 8;
+
+    std::string path_;
+    std::string temp_path_;
+    std::ofstream out_;
+    uint64_t offset_ = 0;
+    bool finished_ = false;
+
+    void WriteBytes(const void* data, size_t size);
+
+    void Align();
+};
+
+// Читает снимок из отображённого файла. Выход за границы файла - runtime_error.
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const MappedFile& file)
+        : data_(file.data())
+        , size_(file.size()) {
+    }
+
+    template <typename T>
+    T Read() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    // Строка указывает в отображённый файл
+    std::string_view ReadString() {
+        const uint64_t size = Read<uint64_t>();
+        return {Take(size), size};
+    }
+
+    // Массив указывает в отображённый файл
+    template <typename T>
+    const T* ReadArray(size_t& count) {
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= ALIGNMENT);
+        const uint64_t size = Read<uint64_t>();
+        Take((ALIGNMENT - offset_ % ALIGNMENT) % ALIGNMENT);
+        if (size > (size_ - offset_) / sizeof(T)) {
+            throw std::runtime_error("Snapshot is truncated");
+        }
+        count = size;
+        return reinterpret_cast<const T*>(Take(size * sizeof(T)));
+    }
+
+    bool AtEnd() const {
+        return offset_ == size_;
+    }
+
+private:
+    static constexpr size_t ALIGNMENT = 8;
+
+    const char* data_;
+    size_t size_;
+    size_t offset_ = 0;
+
+    const char* Take(size_t size) {
+        if (size > size_ - offset_) {
+            throw std::runtime_error("Snapshot is truncated");
+        }
+        const char* result = data_ + offset_;
+        offset_ += size;
+        return result;
+    }
+};
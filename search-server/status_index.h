@@ -0,0 +1,73 @@
+#pragma once
+
+#include "document.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
+// Живые документы по статусам: на каждый статус битовая карта порядковых номеров.
+// Позволяет перечислить документы нужных статусов, не просматривая остальные.
+class StatusIndex {
+public:
+    void Insert(uint32_t ordinal, DocumentStatus status) {
+        auto& bits = bits_[static_cast<size_t>(status)];
+        if (bits.size() <= ordinal / 64) {
+            bits.resize(ordinal / 64 + 1, 0);
+        }
+        bits[ordinal / 64] |= uint64_t{1} << (ordinal % 64);
+        ++document_counts_[static_cast<size_t>(status)];
+    }
+
+    void Erase(uint32_t ordinal, DocumentStatus status) {
+        bits_[static_cast<size_t>(status)][ordinal / 64] &= ~(uint64_t{1} << (ordinal % 64));
+        --document_counts_[static_cast<size_t>(status)];
+    }
+
+    void Clear() {
+        *this = StatusIndex();
+    }
+
+    size_t GetDocumentCount(DocumentStatus status) const {
+        return document_counts_[static_cast<size_t>(status)];
+    }
+
+    // Вызывает function(ordinal) по возрастанию номеров для документов, чей статус
+    // отмечен в status_mask битом 1 << status
+    template <typename Function>
+    void ForEach(uint8_t status_mask, Function function) const {
+        size_t word_count = 0;
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+            if (status_mask >> status & 1) {
+                word_count = std::max(word_count, bits_[status].size());
+            }
+        }
+        for (size_t word = 0; word < word_count; ++word) {
+            uint64_t bits = 0;
+            for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+                if ((status_mask >> status & 1) && word < bits_[status].size()) {
+                    bits |= bits_[status][word];
+                }
+            }
+            for (; bits != 0; bits &= bits - 1) {
+                function(static_cast<uint32_t>(word * 64 + __builtin_ctzll(bits)));
+            }
+        }
+    }
+
+    size_t GetMemoryUsage() const {
+        size_t bytes = 0;
+        for (const auto& bits : bits_) {
+            bytes += bits.capacity() * sizeof(uint64_t);
+        }
+        return bytes;
+    }
+
+private:
+    std::array<std::vector<uint64_t>, DOCUMENT_STATUS_COUNT> bits_;
+    std::array<size_t, DOCUMENT_STATUS_COUNT> document_counts_{};
+};
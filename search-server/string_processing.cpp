@@ -1,5 +1,11 @@
 #include "string_processing.h"
 
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 std::vector<std::string> SplitIntoWords(const std::string& text) {
     std::vector<std::string> words;
     std::string word;
@@ -21,16 +27,110 @@ std::vector<std::string> SplitIntoWords(const std::string& text) {
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text){
     std::vector<std::string_view> words;
-    auto pos = text.find_first_not_of(" ");
-    const auto pos_end = text.npos;
-    text.remove_prefix(std::min((text.size()), pos));
-
-    while (!text.empty()) {
-        auto space = text.find(' ');
-        words.push_back(space == pos_end ? text.substr(0) : text.substr(0, space));
-        pos = text.find_first_not_of(" ", space);
-        text.remove_prefix(std::min(text.size(), pos));
+    SplitIntoWords(text, words);
+    return words;
+}
+
+namespace {
+
+bool IsControl(char c) {
+    return static_cast<unsigned char>(c) < ' ';
+}
+
+// Разбирает text начиная с позиции pos. word_start - начало незавершённого слова
+// или npos, если pos попадает между словами.
+bool SplitTail(std::string_view text, size_t pos, size_t word_start, std::vector<std::string_view>& words) {
+    bool is_valid = true;
+    for (; pos < text.size(); ++pos) {
+        const char c = text[pos];
+        if (c == ' ') {
+            if (word_start != std::string_view::npos) {
+                words.push_back(text.substr(word_start, pos - word_start));
+                word_start = std::string_view::npos;
+            }
+        } else {
+            is_valid &= !IsControl(c);
+            if (word_start == std::string_view::npos) {
+                word_start = pos;
+            }
+        }
+    }
+    if (word_start != std::string_view::npos) {
+        words.push_back(text.substr(word_start));
     }
+    return is_valid;
+}
 
-    return words;
+#if defined(__AVX2__) || defined(__SSE2__)
+
+#if defined(__AVX2__)
+constexpr size_t BLOCK_SIZE = 32;
+
+// Битовые маски пробелов и управляющих символов блока: бит i соответствует байту i
+void ClassifyBlock(const char* data, uint64_t& spaces, uint64_t& controls) {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    spaces = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' '))));
+    // беззнаковое сравнение c <= 31 через минимум
+    const __m256i control_limit = _mm256_set1_epi8(' ' - 1);
+    controls = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_min_epu8(block, control_limit), block)));
+}
+#else
+constexpr size_t BLOCK_SIZE = 16;
+
+void ClassifyBlock(const char* data, uint64_t& spaces, uint64_t& controls) {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    spaces = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(' '))));
+    const __m128i control_limit = _mm_set1_epi8(' ' - 1);
+    controls = static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_min_epu8(block, control_limit), block)));
+}
+#endif
+
+bool SplitVectorized(std::string_view text, std::vector<std::string_view>& words) {
+    uint64_t controls_seen = 0;
+    // был ли пробелом последний байт предыдущего блока; текст как будто начинается с пробела
+    uint64_t previous_space = 1;
+    size_t word_start = std::string_view::npos;
+    size_t pos = 0;
+    for (; pos + BLOCK_SIZE <= text.size(); pos += BLOCK_SIZE) {
+        uint64_t spaces;
+        uint64_t controls;
+        ClassifyBlock(text.data() + pos, spaces, controls);
+        controls_seen |= controls;
+        // биты, где пробел сменяется словом или слово пробелом
+        uint64_t boundaries = spaces ^ ((spaces << 1) | previous_space);
+        boundaries &= (uint64_t{1} << BLOCK_SIZE) - 1;
+        previous_space = (spaces >> (BLOCK_SIZE - 1)) & 1;
+        while (boundaries != 0) {
+            const size_t offset = __builtin_ctzll(boundaries);
+            boundaries &= boundaries - 1;
+            if (word_start == std::string_view::npos) {
+                word_start = pos + offset;
+            } else {
+                words.push_back(text.substr(word_start, pos + offset - word_start));
+                word_start = std::string_view::npos;
+            }
+        }
+    }
+    // управляющий символ не бывает пробелом, так что маска отмечает только байты слов
+    return SplitTail(text, pos, word_start, words) && controls_seen == 0;
+}
+
+#endif
+
+}
+
+bool SplitIntoWordsScalar(std::string_view text, std::vector<std::string_view>& words) {
+    words.clear();
+    return SplitTail(text, 0, std::string_view::npos, words);
+}
+
+bool SplitIntoWords(std::string_view text, std::vector<std::string_view>& words) {
+#if defined(__AVX2__) || defined(__SSE2__)
+    words.clear();
+    return SplitVectorized(text, words);
+#else
+    return SplitIntoWordsScalar(text, words);
+#endif
 }
\ No newline at end of file
@@ -8,6 +8,15 @@ std::vector<std::string> SplitIntoWords(const std::string& text);
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+// Разбивает text на слова по пробелам за один проход, заменяя содержимое words.
+// Заодно проверяет текст на управляющие символы (коды от 0 до 31): если они есть,
+// возвращает false, и слова с ними нужно отбросить или проверить отдельно.
+// Использует SSE2/AVX2, если они доступны при компиляции.
+bool SplitIntoWords(std::string_view text, std::vector<std::string_view>& words);
+
+// То же без векторных инструкций
+bool SplitIntoWordsScalar(std::string_view text, std::vector<std::string_view>& words);
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
@@ -0,0 +1,81 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+// Память, выделенная строкой в куче (короткие строки хранятся внутри объекта)
+size_t GetHeapBytes(const string& text) {
+    const char* object = reinterpret_cast<const char*>(&text);
+    const bool is_inline = text.data() >= object && text.data() < object + sizeof(text);
+    return is_inline ? 0 : text.capacity() + 1;
+}
+
+}
+
+TermId TermDictionary::Acquire(string_view word, size_t references) {
+    if (auto it = ids_.find(word); it != ids_.end()) {
+        terms_[it->second].references += references;
+        return it->second;
+    }
+    TermId id = terms_.size();
+    if (free_ids_.empty()) {
+        terms_.push_back({string(word), references});
+    } else {
+        id = free_ids_.back();
+        free_ids_.pop_back();
+        terms_[id] = {string(word), references};
+    }
+    text_bytes_ += GetHeapBytes(terms_[id].text);
+    ids_.emplace(terms_[id].text, id);
+    return id;
+}
+
+void TermDictionary::Release(TermId term) {
+    if (term >= terms_.size() || terms_[term].references == 0) {
+        throw invalid_argument("Term "s + to_string(term) + " is not in dictionary"s);
+    }
+    Term& entry = terms_[term];
+    if (--entry.references == 0) {
+        ids_.erase(entry.text);
+        text_bytes_ -= GetHeapBytes(entry.text);
+        string().swap(entry.text);
+        free_ids_.push_back(term);
+    }
+}
+
+void TermDictionary::Assign(const vector<pair<string_view, size_t>>& terms) {
+    terms_.clear();
+    free_ids_.clear();
+    ids_.clear();
+    ids_.reserve(terms.size());
+    text_bytes_ = 0;
+    for (const auto& [word, references] : terms) {
+        const TermId id = terms_.size();
+        if (references == 0) {
+            terms_.emplace_back();
+            free_ids_.push_back(id);
+            continue;
+        }
+        terms_.push_back({string(word), references});
+        text_bytes_ += GetHeapBytes(terms_.back().text);
+        if (!ids_.emplace(terms_.back().text, id).second) {
+            throw invalid_argument("Term "s + string(word) + " is duplicated"s);
+        }
+    }
+    // свободные id выдаются начиная с меньших
+    reverse(free_ids_.begin(), free_ids_.end());
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+    // узел хеш-таблицы: ключ, id, хеш и указатель на следующий узел
+    const size_t node_size = sizeof(string_view) + sizeof(TermId) + 2 * sizeof(void*);
+    return terms_.size() * sizeof(Term)
+        + free_ids_.capacity() * sizeof(TermId)
+        + ids_.size() * node_size
+        + ids_.bucket_count() * sizeof(void*)
+        + text_bytes_;
+}
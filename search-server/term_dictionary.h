@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using TermId = uint32_t;
+
+// Словарь различных слов проиндексированных документов.
+// Сопоставляет каждому слову плотный числовой id. Слово хранится в одном экземпляре
+// со счётчиком ссылок и удаляется, когда на него не остаётся ссылок; id удалённых
+// слов переиспользуются.
+class TermDictionary {
+public:
+    static constexpr TermId NO_TERM = UINT32_MAX;
+
+    // Возвращает id слова, добавляя его при необходимости, и увеличивает счётчик ссылок на references
+    TermId Acquire(std::string_view word, size_t references = 1);
+
+    // Уменьшает счётчик ссылок слова, при обнулении удаляет его
+    void Release(TermId term);
+
+    // id слова или NO_TERM, если слова в словаре нет
+    TermId Find(std::string_view word) const {
+        const auto it = ids_.find(word);
+        return it == ids_.end() ? NO_TERM : it->second;
+    }
+
+    // Текст слова, действителен до удаления слова из словаря
+    std::string_view GetText(TermId term) const {
+        return terms_[term].text;
+    }
+
+    // Число ссылок на слово, 0 для свободного id
+    size_t GetReferences(TermId term) const {
+        return terms_[term].references;
+    }
+
+    // Заменяет содержимое словаря: слово terms[i] получает id i и счётчик ссылок из пары.
+    // id с нулевым счётчиком ссылок считаются свободными.
+    void Assign(const std::vector<std::pair<std::string_view, size_t>>& terms);
+
+    // Число различных слов
+    size_t size() const {
+        return ids_.size();
+    }
+
+    // Верхняя граница id: все id меньше IdBound()
+    size_t IdBound() const {
+        return terms_.size();
+    }
+
+    // Оценка занимаемой памяти в байтах
+    size_t GetMemoryUsage() const;
+
+private:
+    struct Term {
+        std::string text;
+        size_t references = 0;
+    };
+
+    // deque не перемещает элементы при добавлении, поэтому ключи ids_ могут указывать на Term::text
+    std::deque<Term> terms_;
+    std::vector<TermId> free_ids_;
+    std::unordered_map<std::string_view, TermId> ids_;
+    size_t text_bytes_ = 0;
+};
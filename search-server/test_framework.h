@@ -0,0 +1,118 @@
+#pragma once
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+template <class T>
+std::ostream& operator<<(std::ostream& os, const std::vector<T>& s);
+
+template <class T>
+std::ostream& operator<<(std::ostream& os, const std::set<T>& s);
+
+template <class K, class V>
+std::ostream& operator<<(std::ostream& os, const std::map<K, V>& m);
+
+template <class First, class Second>
+std::ostream& operator<<(std::ostream& os, const std::pair<First, Second>& p) {
+    return os << '(' << p.first << ", " << p.second << ')';
+}
+
+template <class Container>
+std::ostream& PrintRange(std::ostream& os, const Container& container, char open, char close) {
+    os << open;
+    bool first = true;
+    for (const auto& x : container) {
+        if (!first) {
+            os << ", ";
+        }
+        first = false;
+        os << x;
+    }
+    return os << close;
+}
+
+template <class T>
+std::ostream& operator<<(std::ostream& os, const std::vector<T>& s) {
+    return PrintRange(os, s, '[', ']');
+}
+
+template <class T>
+std::ostream& operator<<(std::ostream& os, const std::set<T>& s) {
+    return PrintRange(os, s, '{', '}');
+}
+
+template <class K, class V>
+std::ostream& operator<<(std::ostream& os, const std::map<K, V>& m) {
+    return PrintRange(os, m, '{', '}');
+}
+
+template <class T, class U>
+void AssertEqual(const T& t, const U& u, const std::string& hint = {}) {
+    if (!(t == u)) {
+        std::ostringstream os;
+        os << "Assertion failed: " << t << " != " << u;
+        if (!hint.empty()) {
+            os << " hint: " << hint;
+        }
+        throw std::runtime_error(os.str());
+    }
+}
+
+inline void Assert(bool b, const std::string& hint) {
+    AssertEqual(b, true, hint);
+}
+
+// Запускает тесты и подсчитывает упавшие; при наличии упавших завершает программу с кодом 1
+class TestRunner {
+public:
+    template <class TestFunc>
+    void RunTest(TestFunc func, const std::string& test_name) {
+        try {
+            func();
+            std::cerr << test_name << " OK" << std::endl;
+        } catch (std::exception& e) {
+            ++fail_count_;
+            std::cerr << test_name << " fail: " << e.what() << std::endl;
+        } catch (...) {
+            ++fail_count_;
+            std::cerr << "Unknown exception caught" << std::endl;
+        }
+    }
+
+    ~TestRunner() {
+        std::cerr.flush();
+        if (fail_count_ > 0) {
+            std::cerr << fail_count_ << " unit tests failed. Terminate" << std::endl;
+            exit(1);
+        }
+    }
+
+private:
+    int fail_count_ = 0;
+};
+
+#define ASSERT_EQUAL(x, y)                                                   \
+    {                                                                        \
+        std::ostringstream __assert_equal_private_os;                        \
+        __assert_equal_private_os << #x << " != " << #y << ", " << __FILE__ \
+                                  << ":" << __LINE__;                        \
+        AssertEqual(x, y, __assert_equal_private_os.str());                  \
+    }
+
+#define ASSERT(x)                                                            \
+    {                                                                        \
+        std::ostringstream __assert_private_os;                              \
+        __assert_private_os << #x << " is false, " << __FILE__ << ":"        \
+                            << __LINE__;                                     \
+        Assert(static_cast<bool>(x), __assert_private_os.str());             \
+    }
+
+#define RUN_TEST(tr, func) tr.RunTest(func, #func)
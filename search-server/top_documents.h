@@ -0,0 +1,82 @@
+#pragma once
+
+#include "document.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+const double PRESICION_RELEVANCE = 1e-6;
+
+// Порядок выдачи: по убыванию релевантности, при равной (с точностью
+// PRESICION_RELEVANCE) релевантности - по убыванию рейтинга,
+// полные совпадения упорядочены по id, чтобы выдача не зависела от порядка обхода
+inline bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < PRESICION_RELEVANCE) {
+        return lhs.rating > rhs.rating || (lhs.rating == rhs.rating && lhs.id < rhs.id);
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+// Отбирает не более capacity самых релевантных документов.
+// Хранит кучу, на вершине которой худший из отобранных документов,
+// так что Push стоит O(log capacity) и не требует сортировки всей выдачи.
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t capacity) : capacity_(capacity) {
+        heap_.reserve(capacity);
+    }
+
+    // Очищает отбор, сохраняя выделенную память
+    void Reset(size_t capacity) {
+        heap_.clear();
+        capacity_ = capacity;
+        heap_.reserve(capacity);
+    }
+
+    void Push(const Document& document) {
+        if (heap_.size() < capacity_) {
+            heap_.push_back(document);
+            std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        } else if (capacity_ > 0 && IsMoreRelevant(document, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+            heap_.back() = document;
+            std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        }
+    }
+
+    // Документ с релевантностью не больше порога не попадёт в отбор ни при каком рейтинге
+    double GetRelevanceThreshold() const {
+        if (capacity_ == 0) {
+            return std::numeric_limits<double>::infinity();
+        }
+        if (heap_.size() < capacity_) {
+            return -std::numeric_limits<double>::infinity();
+        }
+        return heap_.front().relevance - PRESICION_RELEVANCE;
+    }
+
+    // Добавляет документы, отобранные другим экземпляром
+    void Merge(const TopDocuments& other) {
+        for (const Document& document : other.heap_) {
+            Push(document);
+        }
+    }
+
+    std::vector<Document> Extract() {
+        std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        return std::move(heap_);
+    }
+
+    // То же, но в буфер вызывающего, а собственный буфер остаётся для следующего отбора
+    void ExtractTo(std::vector<Document>& result) {
+        std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        result.assign(heap_.begin(), heap_.end());
+        heap_.clear();
+    }
+
+private:
+    size_t capacity_;
+    std::vector<Document> heap_;
+};
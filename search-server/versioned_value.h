@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Закэшированное значение, вычисленное для определённой версии данных.
+// Get можно вызывать из нескольких потоков одновременно: запись кэша защищена
+// счётчиком последовательности (seqlock), поэтому читатель никогда не увидит
+// значение одной версии с номером другой. Если кэш занят другим потоком,
+// значение просто вычисляется заново.
+class VersionedValue {
+public:
+    VersionedValue() = default;
+
+    // Копирование допустимо только когда кэш никто не читает
+    VersionedValue(const VersionedValue& other)
+        : sequence_(other.sequence_.load(std::memory_order_relaxed))
+        , version_(other.version_.load(std::memory_order_relaxed))
+        , value_(other.value_.load(std::memory_order_relaxed)) {
+    }
+
+    VersionedValue& operator=(const VersionedValue& other) {
+        sequence_.store(other.sequence_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        version_.store(other.version_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        value_.store(other.value_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
+    // Возвращает значение для версии version, при необходимости вычисляя его через compute()
+    template <typename Compute>
+    double Get(uint64_t version, Compute compute) const {
+        uint64_t sequence = sequence_.load(std::memory_order_acquire);
+        if (sequence % 2 == 0) {
+            const uint64_t cached_version = version_.load(std::memory_order_relaxed);
+            const double cached_value = value_.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (cached_version == version && sequence_.load(std::memory_order_relaxed) == sequence) {
+                return cached_value;
+            }
+        }
+
+        const double value = compute();
+        // нечётная последовательность означает, что кэш сейчас перезаписывается
+        if (sequence % 2 == 0
+            && sequence_.compare_exchange_strong(sequence, sequence + 1, std::memory_order_relaxed)) {
+            std::atomic_thread_fence(std::memory_order_release);
+            version_.store(version, std::memory_order_relaxed);
+            value_.store(value, std::memory_order_relaxed);
+            sequence_.store(sequence + 2, std::memory_order_release);
+        }
+        return value;
+    }
+
+private:
+    static constexpr uint64_t NO_VERSION = UINT64_MAX;
+
+    mutable std::atomic<uint64_t> sequence_ = 0;
+    mutable std::atomic<uint64_t> version_ = NO_VERSION;
+    mutable std::atomic<double> value_ = 0.0;
+};